@@ -1,16 +1,54 @@
 // Tetris - Pure Matrix Architecture (No Grid Coordinates)
-// Compile: g++ GameXepGach.cpp -o tetris -lGL -lGLU -lglut
+// Compile: g++ GameXepGachFn.cpp -o tetris -lGL -lGLU -lglut
+// Headless simulation core only (no GL/GLU/GLUT):
+//          g++ -O2 -pthread -DTETRIS_HEADLESS GameXepGachFn.cpp -o tetris_headless
+// Allocation self-test build (replaces operator new; "alloccheck" command):
+//          g++ -O2 -pthread -DTETRIS_HEADLESS -DTETRIS_ALLOC_CHECK GameXepGachFn.cpp -o tetris_alloccheck
+// Evolutionary tuner for the bot's evaluation weights (headless):
+//          g++ -O2 -pthread -DTETRIS_HEADLESS -DTETRIS_TUNER GameXepGachFn.cpp -o tetris_tuner
+// Offscreen software-GL render benchmark (EGL surfaceless, e.g. Mesa llvmpipe):
+//          g++ -O2 -DTETRIS_RENDER_BENCH GameXepGachFn.cpp -o tetris_render_bench -lEGL -lGL -lGLU -lglut
+// Profiling build of any of these: add -DTETRIS_PROFILE ('p' toggles the
+// timing overlay, 't' writes tetris_trace.json; headless: "profile")
 
+#ifndef TETRIS_HEADLESS
 #include <GL/gl.h>
 #include <GL/glu.h>
 #include <GL/glut.h>
+#ifdef FREEGLUT
+#include <GL/freeglut_ext.h>
+#endif
+#ifdef TETRIS_RENDER_BENCH
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#endif
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
 #include <vector>
+#include <array>
 #include <string>
 #include <iostream>
 #include <cmath>
-#include <map>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #ifdef RGB
 #undef RGB
@@ -29,9 +67,13 @@ namespace Config {
     const int WINDOW_W = CELL * (BOARD_W + 6);
     const int WINDOW_H = CELL * BOARD_H;
     const float DEFAULT_DROP_INTERVAL = 500.0f;
+    const int DEFAULT_TICK_RATE = 60;           // Simulation ticks per second
+    const int DEFAULT_MAX_FPS = 120;            // Frame pacing cap, 0 = uncapped
+    const int MAX_FRAME_STEP_MS = 250;          // Longest stall simulated in one go
+    const int UNDO_DEPTH = 32;                  // Pieces the front-end can take back
     const float PANEL_X_OFFSET = 20;
     const float PANEL_PREVIEW_SCALE = 12.0f;
-    const float COLLISION_EPSILON = 0.4f;
+    const float GHOST_SHADE = 0.3f;             // Brightness of the landing preview
 }
 
 // ============================================================================
@@ -126,6 +168,308 @@ namespace Math {
     }
 }
 
+// ============================================================================
+// RANDOM MODULE
+// ============================================================================
+
+namespace Random {
+    inline uint32_t rotl(uint32_t x, int k) {
+        return (x << k) | (x >> (32 - k));
+    }
+
+    constexpr uint64_t splitMix64(uint64_t &state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // One xoshiro128** step on a state held anywhere (struct or SoA arrays)
+    inline uint32_t xoshiroNext(uint32_t &s0, uint32_t &s1, uint32_t &s2, uint32_t &s3) {
+        uint32_t result = rotl(s1 * 5, 7) * 9;
+        uint32_t t = s1 << 9;
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = rotl(s3, 11);
+        return result;
+    }
+
+    // Maps a 32-bit random value onto [0, n) without a division
+    inline uint32_t reduce(uint32_t value, uint32_t n) {
+        return (uint32_t)(((uint64_t)value * n) >> 32);
+    }
+
+    // xoshiro128** (Blackman & Vigna), seeded through SplitMix64
+    struct Xoshiro128 {
+        uint32_t s[4];
+
+        explicit Xoshiro128(uint64_t seed = 0) { reseed(seed); }
+
+        void reseed(uint64_t seed) {
+            uint64_t a = splitMix64(seed);
+            uint64_t b = splitMix64(seed);
+            s[0] = (uint32_t)a;
+            s[1] = (uint32_t)(a >> 32);
+            s[2] = (uint32_t)b;
+            s[3] = (uint32_t)(b >> 32);
+        }
+
+        uint32_t next() { return xoshiroNext(s[0], s[1], s[2], s[3]); }
+        uint32_t nextBelow(uint32_t n) { return reduce(next(), n); }
+    };
+}
+
+// ============================================================================
+// PROFILER MODULE (Scoped Timers, Frame Percentiles, Trace Export)
+// ============================================================================
+
+// Only built with -DTETRIS_PROFILE; otherwise PROFILE_SCOPE expands to
+// nothing and none of this exists. Zone times add up per thread and
+// endFrame() closes them into a frame record on the thread that owns the
+// frame loop; zones on other threads only show up in the trace.
+#ifdef TETRIS_PROFILE
+namespace Profiler {
+    enum Zone {
+        ZONE_GAME_STEP,
+        ZONE_CAN_PLACE,
+        ZONE_CLEAR_LINES,
+        ZONE_DRAW_BOARD,
+        ZONE_DRAW_SIDE_PANEL,
+        ZONE_COUNT
+    };
+
+    const char *const ZONE_NAMES[ZONE_COUNT] = {"Game::step", "canPlace", "clearLines", "drawBoard", "drawSidePanel"};
+    // canPlace runs thousands of times per bot search: it is summed per
+    // frame but too hot to trace call by call
+    const bool ZONE_TRACED[ZONE_COUNT] = {true, false, true, true, true};
+
+    const int FRAME_HISTORY = 1024;         // Frames the percentiles are taken over
+    const int TRACE_CAPACITY = 1 << 16;     // Newest trace events kept
+
+    // Raw timestamps: the TSC where there is one, steady_clock otherwise
+    inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    struct Origin {
+        uint64_t ticks;
+        chrono::steady_clock::time_point time;
+        Origin() : ticks(now()), time(chrono::steady_clock::now()) {}
+    };
+
+    const Origin ORIGIN;
+
+    // Timestamp rate against steady_clock over everything since start-up,
+    // so it gets more precise the longer the program runs
+    inline double ticksPerUs() {
+        uint64_t ticks;
+        double us;
+        do {
+            ticks = now();
+            us = chrono::duration<double, micro>(chrono::steady_clock::now() - ORIGIN.time).count();
+        } while (us < 1000.0);
+        return (double)(ticks - ORIGIN.ticks) / us;
+    }
+
+    // Overwriting ring, lock-free for writers and readers. A writer claims
+    // a slot with one fetch_add; each slot carries the sequence number of
+    // the item in it, stored after the item, so a reader can tell a
+    // complete item from one that is being overwritten and skip it.
+    template <class T, int N>
+    class Ring {
+    private:
+        struct Slot {
+            atomic<uint64_t> seq;
+            T item;
+        };
+
+        Slot slots[N];
+        atomic<uint64_t> head;
+
+    public:
+        Ring() : head(0) {
+            for (Slot &s : slots)
+                s.seq.store(0, memory_order_relaxed);
+        }
+
+        void push(const T &item) {
+            uint64_t i = head.fetch_add(1, memory_order_relaxed);
+            Slot &s = slots[i % N];
+            s.seq.store(0, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+            s.item = item;
+            s.seq.store(i + 1, memory_order_release);
+        }
+
+        // Copies up to limit of the newest complete items, oldest first
+        int read(T *out, int limit) const {
+            uint64_t end = head.load(memory_order_acquire);
+            uint64_t count = min<uint64_t>(end, (uint64_t)min(limit, N));
+            int n = 0;
+            for (uint64_t i = end - count; i < end; i++) {
+                const Slot &s = slots[i % N];
+                if (s.seq.load(memory_order_acquire) != i + 1) continue;
+                T copy = s.item;
+                atomic_thread_fence(memory_order_acquire);
+                if (s.seq.load(memory_order_relaxed) != i + 1) continue;
+                out[n++] = copy;
+            }
+            return n;
+        }
+    };
+
+    struct FrameRecord {
+        uint64_t start, duration;
+        uint64_t zoneTicks[ZONE_COUNT];
+        uint32_t zoneCalls[ZONE_COUNT];
+    };
+
+    // zone == ZONE_COUNT is a whole frame
+    struct TraceEvent {
+        uint64_t start, duration;
+        uint32_t zone;
+        uint32_t thread;
+    };
+
+    Ring<FrameRecord, FRAME_HISTORY> frames;
+    Ring<TraceEvent, TRACE_CAPACITY> events;
+    atomic<uint32_t> threadCount(0);
+
+    struct ThreadZones {
+        uint64_t ticks[ZONE_COUNT];
+        uint32_t calls[ZONE_COUNT];
+        uint64_t frameStart;
+        uint32_t thread;
+
+        ThreadZones() : ticks(), calls(), frameStart(now()),
+                        thread(threadCount.fetch_add(1, memory_order_relaxed) + 1) {}
+    };
+
+    inline ThreadZones &threadZones() {
+        thread_local ThreadZones zones;
+        return zones;
+    }
+
+    class Scope {
+    private:
+        Zone zone;
+        uint64_t start;
+
+    public:
+        explicit Scope(Zone z) : zone(z), start(now()) {}
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope() {
+            uint64_t duration = now() - start;
+            ThreadZones &t = threadZones();
+            t.ticks[zone] += duration;
+            t.calls[zone]++;
+            if (ZONE_TRACED[zone])
+                events.push(TraceEvent{start, duration, (uint32_t)zone, t.thread});
+        }
+    };
+
+    // Closes the calling thread's frame: everything since its previous
+    // endFrame() (or its first zone)
+    inline void endFrame() {
+        ThreadZones &t = threadZones();
+        uint64_t end = now();
+        FrameRecord r;
+        r.start = t.frameStart;
+        r.duration = end - t.frameStart;
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            r.zoneTicks[z] = t.ticks[z];
+            r.zoneCalls[z] = t.calls[z];
+            t.ticks[z] = 0;
+            t.calls[z] = 0;
+        }
+        frames.push(r);
+        events.push(TraceEvent{r.start, r.duration, (uint32_t)ZONE_COUNT, t.thread});
+        t.frameStart = end;
+    }
+
+    struct Percentiles {
+        double p50, p99, max;       // Milliseconds
+        double callsPerFrame;
+        int frames;
+    };
+
+    // Over the recorded frames: the frame time itself for zone ==
+    // ZONE_COUNT, otherwise that zone's total time in each frame
+    inline Percentiles framePercentiles(int zone) {
+        thread_local FrameRecord records[FRAME_HISTORY];
+        thread_local double ms[FRAME_HISTORY];
+        Percentiles p = {};
+        int n = frames.read(records, FRAME_HISTORY);
+        if (n == 0) return p;
+
+        double msPerTick = 1.0 / (ticksPerUs() * 1000.0);
+        long calls = 0;
+        for (int i = 0; i < n; i++) {
+            const FrameRecord &r = records[i];
+            ms[i] = (double)(zone == ZONE_COUNT ? r.duration : r.zoneTicks[zone]) * msPerTick;
+            calls += zone == ZONE_COUNT ? 1 : r.zoneCalls[zone];
+        }
+        nth_element(ms, ms + n / 2, ms + n);
+        p.p50 = ms[n / 2];
+        int i99 = min(n - 1, n * 99 / 100);
+        nth_element(ms, ms + i99, ms + n);
+        p.p99 = ms[i99];
+        p.max = *max_element(ms + i99, ms + n);
+        p.callsPerFrame = (double)calls / n;
+        p.frames = n;
+        return p;
+    }
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto): one complete
+    // event per traced zone and frame, plus per-frame canPlace counters
+    inline bool exportTrace(const char *path) {
+        FILE *f = fopen(path, "w");
+        if (!f) return false;
+        vector<TraceEvent> traced(TRACE_CAPACITY);
+        int n = events.read(traced.data(), TRACE_CAPACITY);
+        vector<FrameRecord> recorded(FRAME_HISTORY);
+        int frameCount = frames.read(recorded.data(), FRAME_HISTORY);
+        double perUs = ticksPerUs();
+        auto us = [&](uint64_t ticks) { return (double)(ticks - ORIGIN.ticks) / perUs; };
+
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        const char *separator = "";
+        for (int i = 0; i < n; i++) {
+            const TraceEvent &e = traced[i];
+            fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"tetris\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    separator, e.zone == ZONE_COUNT ? "frame" : ZONE_NAMES[e.zone], us(e.start),
+                    (double)e.duration / perUs, e.thread);
+            separator = ",\n";
+        }
+        for (int i = 0; i < frameCount; i++) {
+            const FrameRecord &r = recorded[i];
+            fprintf(f, "%s{\"name\":\"canPlace\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"calls\":%u,\"us\":%.3f}}",
+                    separator, us(r.start), r.zoneCalls[ZONE_CAN_PLACE],
+                    (double)r.zoneTicks[ZONE_CAN_PLACE] / perUs);
+            separator = ",\n";
+        }
+        fprintf(f, "\n]}\n");
+        return fclose(f) == 0;
+    }
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(zone) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(Profiler::zone)
+#else
+#define PROFILE_SCOPE(zone)
+#endif
+
 // ============================================================================
 // COLOR MODULE
 // ============================================================================
@@ -159,10 +503,12 @@ namespace Color {
         }
     }
 
+#ifndef TETRIS_HEADLESS
     inline void setGLColor(int colorIdx) {
         RGB color = getColorRGB(colorIdx);
         glColor3f(color.r, color.g, color.b);
     }
+#endif
 }
 
 // ============================================================================
@@ -172,161 +518,259 @@ namespace Color {
 namespace Tetromino {
     using namespace Math;
 
-    struct Block {
-        Vec2 localPos;
-        int color;
-        
-        Vec2 getWorldPos(const Mat3& transform) const {
-            return applyMat3(transform, localPos);
-        }
+    enum PieceType {
+        PIECE_I = 0,
+        PIECE_O,
+        PIECE_T,
+        PIECE_S,
+        PIECE_Z,
+        PIECE_J,
+        PIECE_L,
+        PIECE_COUNT
+    };
+
+    const int PIECE_BLOCKS = 4;
+    const int ROTATIONS = 4;
+
+    // Horizontal offsets tried, in order, when a rotation does not fit in place
+    constexpr int WALL_KICKS[4] = {-1, 1, -2, 2};
+
+    struct Cell {
+        int x, y;
+    };
+
+    // Spawn orientation of every piece, offsets from the rotation origin
+    constexpr Cell BASE_SHAPES[PIECE_COUNT][PIECE_BLOCKS] = {
+        {{-2, 0}, {-1, 0}, {0, 0}, {1, 0}},   // I (centered between blocks for proper rotation)
+        {{0, 0}, {1, 0}, {0, 1}, {1, 1}},     // O
+        {{-1, 0}, {0, 0}, {1, 0}, {0, 1}},    // T
+        {{0, 0}, {1, 0}, {-1, 1}, {0, 1}},    // S
+        {{-1, 0}, {0, 0}, {0, 1}, {1, 1}},    // Z
+        {{-1, 0}, {0, 0}, {1, 0}, {1, 1}},    // J
+        {{-1, 0}, {0, 0}, {1, 0}, {-1, 1}}    // L
+    };
+
+    constexpr int PIECE_COLORS[PIECE_COUNT] = {
+        Color::CYAN, Color::YELLOW, Color::PURPLE, Color::GREEN,
+        Color::RED, Color::BLUE, Color::ORANGE
+    };
+
+    // One piece in one orientation. rows[i] holds the cells of row minY + i,
+    // bit 0 = column minX, so collision is a shift and an AND per row.
+    // columnBottom[i] is the lowest cell offset in column minX + i.
+    struct RotationState {
+        Cell cells[PIECE_BLOCKS];
+        int minX, maxX, minY, maxY;
+        uint8_t rows[PIECE_BLOCKS];
+        int columnBottom[PIECE_BLOCKS];
+    };
+
+    struct RotationTable {
+        RotationState states[PIECE_COUNT][ROTATIONS];
     };
 
+    constexpr RotationTable buildRotationTable() {
+        RotationTable table{};
+        for (int type = 0; type < PIECE_COUNT; type++) {
+            for (int rot = 0; rot < ROTATIONS; rot++) {
+                RotationState &st = table.states[type][rot];
+                for (int i = 0; i < PIECE_BLOCKS; i++) {
+                    if (rot == 0) {
+                        st.cells[i] = BASE_SHAPES[type][i];
+                    } else {
+                        // +90 degrees about the origin, same as matRotate(90)
+                        const Cell &prev = table.states[type][rot - 1].cells[i];
+                        st.cells[i] = Cell{prev.y, -prev.x};
+                    }
+                }
+
+                st.minX = st.maxX = st.cells[0].x;
+                st.minY = st.maxY = st.cells[0].y;
+                for (int i = 1; i < PIECE_BLOCKS; i++) {
+                    if (st.cells[i].x < st.minX) st.minX = st.cells[i].x;
+                    if (st.cells[i].x > st.maxX) st.maxX = st.cells[i].x;
+                    if (st.cells[i].y < st.minY) st.minY = st.cells[i].y;
+                    if (st.cells[i].y > st.maxY) st.maxY = st.cells[i].y;
+                }
+                for (int i = 0; i < PIECE_BLOCKS; i++)
+                    st.columnBottom[i] = st.minY - 1;
+                for (int i = 0; i < PIECE_BLOCKS; i++) {
+                    const Cell &c = st.cells[i];
+                    st.rows[c.y - st.minY] |= (uint8_t)(1u << (c.x - st.minX));
+                    if (c.y > st.columnBottom[c.x - st.minX])
+                        st.columnBottom[c.x - st.minX] = c.y;
+                }
+            }
+        }
+        return table;
+    }
+
+    constexpr RotationTable ROTATION_TABLE = buildRotationTable();
+
+    // Compact value type: moving and rotating are integer updates, the
+    // shape itself always comes from ROTATION_TABLE.
     class Piece {
     public:
-        vector<Block> blocks;
+        int type;
+        int rotation;
+        int x, y;
         int colorIndex;
-        Mat3 transform;
 
-        Piece() : colorIndex(0) {
-            transform = matIdentity();
+        Piece() : type(-1), rotation(0), x(0), y(0), colorIndex(0) {}
+
+        explicit Piece(int pieceType)
+            : type(pieceType), rotation(0), x(0), y(0), colorIndex(PIECE_COLORS[pieceType]) {}
+
+        bool isEmpty() const { return type < 0; }
+
+        const RotationState &state() const {
+            return ROTATION_TABLE.states[type][rotation];
         }
 
-        vector<Vec2> getWorldPositions() const {
-            vector<Vec2> positions;
-            for (const auto &block : blocks) {
-                positions.push_back(block.getWorldPos(transform));
+        Cell cell(int i) const {
+            const Cell &c = state().cells[i];
+            return Cell{x + c.x, y + c.y};
+        }
+
+        array<Vec2, PIECE_BLOCKS> getWorldPositions() const {
+            array<Vec2, PIECE_BLOCKS> positions;
+            for (int i = 0; i < PIECE_BLOCKS; i++) {
+                Cell c = cell(i);
+                positions[i] = Vec2((float)c.x, (float)c.y);
             }
             return positions;
         }
 
-        void translate(float dx, float dy) {
-            Mat3 T = matTranslate(dx, dy);
-            transform = matMul(transform, T);  // M_new = M_old   T (row-vector convention)
+        void translate(int dx, int dy) {
+            x += dx;
+            y += dy;
+        }
+
+        void rotate() {
+            rotation = (rotation + 1) & (ROTATIONS - 1);
         }
 
-        void rotate(float angleDeg) {
-            Vec2 center = applyMat3(transform, Vec2(0, 0));
-            Mat3 T1 = matTranslate(-center.x, -center.y);
-            Mat3 R = matRotate(angleDeg);
-            Mat3 T2 = matTranslate(center.x, center.y);
-            Mat3 combined = matMul(matMul(T1, R), T2);  // Combine: T1   R   T2
-            transform = matMul(transform, combined);  // M_new = M_old   combined (row-vector convention)
+        // Rendering transform equivalent to the table lookup (local -> world)
+        Mat3 getTransform() const {
+            return matMul(matRotate(90.0f * rotation), matTranslate((float)x, (float)y));
         }
     };
 
+    enum Randomizer {
+        RANDOMIZER_UNIFORM = 0,     // Independent uniform draw per piece
+        RANDOMIZER_BAG7 = 1         // Shuffled bag of all 7 pieces, refilled when empty
+    };
+
+    // Per-instance, seedable piece generator. The same seed and mode always
+    // produce the same sequence, independent of other factories or threads.
     class PieceFactory {
     private:
-        vector<Piece> templates;
+        Piece templates[PIECE_COUNT];
+        Random::Xoshiro128 rng;
+        uint64_t seed;
+        Randomizer mode;
+        uint8_t bag[PIECE_COUNT];
+        int bagRemaining;
+
+        void refillBag() {
+            for (int i = 0; i < PIECE_COUNT; i++)
+                bag[i] = (uint8_t)i;
+            for (int i = PIECE_COUNT - 1; i > 0; i--) {
+                int j = (int)rng.nextBelow((uint32_t)(i + 1));
+                uint8_t tmp = bag[i];
+                bag[i] = bag[j];
+                bag[j] = tmp;
+            }
+            bagRemaining = PIECE_COUNT;
+        }
 
     public:
-        PieceFactory() {
+        explicit PieceFactory(uint64_t seed = 0, Randomizer mode = RANDOMIZER_UNIFORM)
+            : rng(seed), seed(seed), mode(mode), bagRemaining(0) {
             initTemplates();
         }
 
+        void reseed(uint64_t newSeed) {
+            seed = newSeed;
+            rng.reseed(newSeed);
+            bagRemaining = 0;
+        }
+
+        void reseed(uint64_t newSeed, Randomizer newMode) {
+            mode = newMode;
+            reseed(newSeed);
+        }
+
         void initTemplates() {
-            templates.clear();
+            for (int type = 0; type < PIECE_COUNT; type++)
+                templates[type] = Piece(type);
+        }
 
-            // I-piece (centered between blocks for proper rotation)
-            {
-                Piece piece;
-                piece.colorIndex = Color::CYAN;
-                piece.blocks = {
-                    {Vec2(-2, 0), Color::CYAN},
-                    {Vec2(-1, 0), Color::CYAN},
-                    {Vec2(0, 0), Color::CYAN},
-                    {Vec2(1, 0), Color::CYAN}
-                };
-                templates.push_back(piece);
-            }
-
-            // O-piece (centered at origin)
-            {
-                Piece piece;
-                piece.colorIndex = Color::YELLOW;
-                piece.blocks = {
-                    {Vec2(0, 0), Color::YELLOW},
-                    {Vec2(1, 0), Color::YELLOW},
-                    {Vec2(0, 1), Color::YELLOW},
-                    {Vec2(1, 1), Color::YELLOW}
-                };
-                templates.push_back(piece);
-            }
-
-            // T-piece
-            {
-                Piece piece;
-                piece.colorIndex = Color::PURPLE;
-                piece.blocks = {
-                    {Vec2(-1, 0), Color::PURPLE},
-                    {Vec2(0, 0), Color::PURPLE},
-                    {Vec2(1, 0), Color::PURPLE},
-                    {Vec2(0, 1), Color::PURPLE}
-                };
-                templates.push_back(piece);
-            }
-
-            // S-piece
-            {
-                Piece piece;
-                piece.colorIndex = Color::GREEN;
-                piece.blocks = {
-                    {Vec2(0, 0), Color::GREEN},
-                    {Vec2(1, 0), Color::GREEN},
-                    {Vec2(-1, 1), Color::GREEN},
-                    {Vec2(0, 1), Color::GREEN}
-                };
-                templates.push_back(piece);
-            }
-
-            // Z-piece
-            {
-                Piece piece;
-                piece.colorIndex = Color::RED;
-                piece.blocks = {
-                    {Vec2(-1, 0), Color::RED},
-                    {Vec2(0, 0), Color::RED},
-                    {Vec2(0, 1), Color::RED},
-                    {Vec2(1, 1), Color::RED}
-                };
-                templates.push_back(piece);
-            }
-
-            // J-piece
-            {
-                Piece piece;
-                piece.colorIndex = Color::BLUE;
-                piece.blocks = {
-                    {Vec2(-1, 0), Color::BLUE},
-                    {Vec2(0, 0), Color::BLUE},
-                    {Vec2(1, 0), Color::BLUE},
-                    {Vec2(1, 1), Color::BLUE}
-                };
-                templates.push_back(piece);
-            }
-
-            // L-piece
-            {
-                Piece piece;
-                piece.colorIndex = Color::ORANGE;
-                piece.blocks = {
-                    {Vec2(-1, 0), Color::ORANGE},
-                    {Vec2(0, 0), Color::ORANGE},
-                    {Vec2(1, 0), Color::ORANGE},
-                    {Vec2(-1, 1), Color::ORANGE}
-                };
-                templates.push_back(piece);
+        int nextType() {
+            if (mode == RANDOMIZER_BAG7) {
+                if (bagRemaining == 0)
+                    refillBag();
+                return bag[--bagRemaining];
+            }
+            return (int)rng.nextBelow(PIECE_COUNT);
+        }
+
+        // Pre-generates the next count piece types into out; continues the
+        // same sequence createRandomPiece would have produced.
+        void generateQueue(uint8_t *out, size_t count) {
+            if (mode == RANDOMIZER_UNIFORM) {
+                for (size_t i = 0; i < count; i++)
+                    out[i] = (uint8_t)rng.nextBelow(PIECE_COUNT);
+                return;
             }
+            for (size_t i = 0; i < count; i++)
+                out[i] = (uint8_t)nextType();
         }
 
-        Piece createRandomPiece() const {
-            int idx = rand() % templates.size();
-            return templates[idx];
+        Piece createRandomPiece() {
+            return templates[nextType()];
         }
+
+        // Generator position, enough to continue the exact sequence
+        struct State {
+            Random::Xoshiro128 rng;
+            uint64_t seed;
+            uint8_t bag[PIECE_COUNT];
+            int8_t bagRemaining;
+            uint8_t mode;
+        };
+
+        void save(State &out) const {
+            out.rng = rng;
+            out.seed = seed;
+            memcpy(out.bag, bag, sizeof(bag));
+            out.bagRemaining = (int8_t)bagRemaining;
+            out.mode = (uint8_t)mode;
+        }
+
+        void restore(const State &in) {
+            rng = in.rng;
+            seed = in.seed;
+            memcpy(bag, in.bag, sizeof(bag));
+            bagRemaining = in.bagRemaining;
+            mode = (Randomizer)in.mode;
+        }
+
+        uint64_t getSeed() const { return seed; }
+        Randomizer getMode() const { return mode; }
     };
+
+    inline const char *randomizerName(Randomizer mode) {
+        return mode == RANDOMIZER_BAG7 ? "bag" : "uniform";
+    }
+
+    inline Randomizer parseRandomizer(const string &name) {
+        return name == "bag" || name == "7bag" ? RANDOMIZER_BAG7 : RANDOMIZER_UNIFORM;
+    }
 }
 
 // ============================================================================
-// BOARD MODULE (Pure Continuous Space)
+// BOARD MODULE (Row-Major Grid + Row Bitmasks)
 // ============================================================================
 
 namespace Board {
@@ -334,467 +778,553 @@ namespace Board {
     using namespace Config;
     using namespace Math;
 
-    struct LockedBlock {
-        Vec2 position;
-        int color;
-        
-        LockedBlock(const Vec2& pos, int col) : position(pos), color(col) {}
+    // Occupancy of one board row, bit x set = column x filled: the
+    // narrowest unsigned word that holds W columns
+    template <int W>
+    using RowMaskFor = typename conditional<(W <= 16), uint16_t,
+                       typename conditional<(W <= 32), uint32_t, uint64_t>::type>::type;
+
+    template <class Row>
+    inline int lowestBit(Row mask) {
+        return sizeof(Row) > 4 ? __builtin_ctzll((unsigned long long)mask) : __builtin_ctz((unsigned)mask);
+    }
+
+    // Locked-cell colours are Color::ColorType values (0 = empty), packed
+    // two per byte: column x lives in the low nibble of byte x / 2 when x
+    // is even, the high nibble when odd
+    inline int colorAt(const uint8_t *row, int x) {
+        return (row[x >> 1] >> ((x & 1) * 4)) & 0xF;
+    }
+
+    // Range of active-piece origins a search can reach: any pose that fits
+    // lies inside it, and pieces only ever start near the top
+    const int POSE_X_OFFSET = 2;
+    const int POSE_X_RANGE = BOARD_W + 4;
+    const int POSE_Y_OFFSET = 4;
+    const int POSE_Y_RANGE = BOARD_H + 8;
+
+    // Zobrist keys: one per board cell and one per active-piece pose. A
+    // position hashes to the XOR of its filled cells' keys (and its pose's
+    // key), so locking a piece is four XORs. Cell keys exist per board
+    // size; pose keys only for the standard board the search runs on.
+    template <int W, int H>
+    struct CellKeys {
+        uint64_t cells[H][W];
+    };
+
+    template <int W, int H>
+    constexpr CellKeys<W, H> buildCellKeys() {
+        CellKeys<W, H> keys{};
+        uint64_t state = 0x7E7215ull;
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++)
+                keys.cells[y][x] = Random::splitMix64(state);
+        }
+        return keys;
+    }
+
+    template <int W, int H>
+    constexpr CellKeys<W, H> CELL_KEYS = buildCellKeys<W, H>();
+
+    struct ZobristKeys {
+        uint64_t poses[PIECE_COUNT][ROTATIONS][POSE_Y_RANGE][POSE_X_RANGE];
+    };
+
+    constexpr ZobristKeys buildZobristKeys() {
+        ZobristKeys keys{};
+        uint64_t state = 0x905E5ull;
+        for (int t = 0; t < PIECE_COUNT; t++) {
+            for (int r = 0; r < ROTATIONS; r++) {
+                for (int y = 0; y < POSE_Y_RANGE; y++) {
+                    for (int x = 0; x < POSE_X_RANGE; x++)
+                        keys.poses[t][r][y][x] = Random::splitMix64(state);
+                }
+            }
+        }
+        return keys;
+    }
+
+    constexpr ZobristKeys ZOBRIST = buildZobristKeys();
+
+    // Key of the active piece; 0 for poses outside the search range
+    inline uint64_t pieceHash(int type, int rotation, int x, int y) {
+        x += POSE_X_OFFSET;
+        y += POSE_Y_OFFSET;
+        if (x < 0 || x >= POSE_X_RANGE || y < 0 || y >= POSE_Y_RANGE) return 0;
+        return ZOBRIST.poses[type][rotation][y][x];
+    }
+
+    inline uint64_t pieceHash(const Piece &piece) {
+        return piece.isEmpty() ? 0 : pieceHash(piece.type, piece.rotation, piece.x, piece.y);
+    }
+
+    // A piece rasterized into board rows: rows[i] covers board row top + i
+    template <class Row>
+    struct BasicPieceMask {
+        int top;
+        int count;
+        Row rows[4];
+        bool inBounds;
+    };
+
+    // Everything a board needs to resume play, as one flat block: the
+    // collision state and its caches come first (81 bytes at 10x20), the
+    // colour plane follows. Saving or restoring is a fixed-size copy.
+    template <int W, int H>
+    struct BasicBoardState {
+        typedef RowMaskFor<W> Row;
+        static const int COLOR_BYTES = (W + 1) / 2;
+
+        uint64_t hash;
+        Row occupancy[H];
+        uint8_t columnTop[W];
+        uint8_t columnHoles[W];
+        int32_t totalHoles;
+        int32_t score;
+        int32_t linesClearedTotal;
+        bool gameOver;
+        uint8_t colors[H][COLOR_BYTES];
     };
 
-    class GameBoard {
+    // Collision, line clears and the cached surface for a W x H board.
+    // Everything is sized at compile time, so each instantiation is as
+    // specialized as a hand-written board of that size. GameBoard (10x20)
+    // is the one the search, the bot and the SIMD feature kernels use.
+    template <int W, int H>
+    class BasicBoard {
+        static_assert(W >= 4 && W <= 64 && H >= 4 && H < 255, "board size out of range");
+
+    public:
+        typedef RowMaskFor<W> Row;
+        typedef BasicPieceMask<Row> Mask;
+        typedef BasicBoardState<W, H> State;
+        static const int WIDTH = W;
+        static const int HEIGHT = H;
+        static const int COLOR_BYTES = (W + 1) / 2;
+        static constexpr Row FULL_ROW = (Row)(~0ull >> (64 - W));
+
     private:
-        vector<LockedBlock> lockedBlocks;
+        Row occupancy[H];             // Authoritative collision state
+        uint8_t colors[H][COLOR_BYTES];   // Packed 4-bit colour per cell
+        int touchedTop, touchedBottom;          // Rows written by the last lockPiece
+        uint32_t revision;                      // Bumped on every change to the cells
+        uint64_t hash;                          // Zobrist hash of occupancy
+        uint8_t columnTop[W];             // First filled row per column, H if empty
+        uint8_t columnHoles[W];           // Empty cells below columnTop
+        int totalHoles;
         int score;
         int highScore;
         int linesClearedTotal;
         bool gameOver;
 
-        bool overlaps(const Vec2& pos1, const Vec2& pos2) const {
-            return pos1.distance(pos2) < COLLISION_EPSILON;
+        void clearTouched() {
+            touchedTop = H;
+            touchedBottom = -1;
+        }
+
+        void recomputeColumns() {
+            totalHoles = 0;
+            for (int x = 0; x < W; x++) {
+                Row bit = (Row)((Row)1 << x);
+                int top = 0;
+                while (top < H && !(occupancy[top] & bit))
+                    top++;
+                int holes = 0;
+                for (int y = top + 1; y < H; y++) {
+                    if (!(occupancy[y] & bit))
+                        holes++;
+                }
+                columnTop[x] = (uint8_t)top;
+                columnHoles[x] = (uint8_t)holes;
+                totalHoles += holes;
+            }
+        }
+
+        static uint64_t rowHash(int y, Row mask) {
+            uint64_t h = 0;
+            while (mask) {
+                h ^= CELL_KEYS<W, H>.cells[y][lowestBit(mask)];
+                mask &= (Row)(mask - 1);
+            }
+            return h;
+        }
+
+        void moveRows(int dst, int src, int count) {
+            memmove(&occupancy[dst], &occupancy[src], count * sizeof(Row));
+            memmove(&colors[dst], &colors[src], count * sizeof(colors[0]));
         }
 
     public:
-        GameBoard() : score(0), highScore(0), linesClearedTotal(0), gameOver(false) {}
+        BasicBoard() : revision(0), score(0), highScore(0), linesClearedTotal(0), gameOver(false) {
+            reset();
+        }
 
         void reset() {
-            lockedBlocks.clear();
+            memset(occupancy, 0, sizeof(occupancy));
+            memset(colors, 0, sizeof(colors));
+            memset(columnTop, H, sizeof(columnTop));
+            memset(columnHoles, 0, sizeof(columnHoles));
+            totalHoles = 0;
+            hash = 0;
+            clearTouched();
+            revision++;
             score = 0;
             linesClearedTotal = 0;
             gameOver = false;
         }
 
+        void save(State &out) const {
+            out.hash = hash;
+            memcpy(out.occupancy, occupancy, sizeof(occupancy));
+            memcpy(out.columnTop, columnTop, sizeof(columnTop));
+            memcpy(out.columnHoles, columnHoles, sizeof(columnHoles));
+            out.totalHoles = totalHoles;
+            out.score = score;
+            out.linesClearedTotal = linesClearedTotal;
+            out.gameOver = gameOver;
+            memcpy(out.colors, colors, sizeof(colors));
+        }
+
+        // highScore is a session record and is kept across a restore. The
+        // revision moves forward so cached renderer state is rebuilt.
+        void restore(const State &in) {
+            hash = in.hash;
+            memcpy(occupancy, in.occupancy, sizeof(occupancy));
+            memcpy(columnTop, in.columnTop, sizeof(columnTop));
+            memcpy(columnHoles, in.columnHoles, sizeof(columnHoles));
+            totalHoles = in.totalHoles;
+            score = in.score;
+            linesClearedTotal = in.linesClearedTotal;
+            gameOver = in.gameOver;
+            memcpy(colors, in.colors, sizeof(colors));
+            clearTouched();
+            revision++;
+        }
+
+        static Mask buildMask(const Piece &piece) {
+            const RotationState &st = piece.state();
+            Mask mask;
+            mask.top = piece.y + st.minY;
+            mask.count = st.maxY - st.minY + 1;
+            mask.inBounds = piece.x + st.minX >= 0 && piece.x + st.maxX < W &&
+                            piece.y + st.maxY < H;
+            int shift = mask.inBounds ? piece.x + st.minX : 0;
+            for (int i = 0; i < PIECE_BLOCKS; i++)
+                mask.rows[i] = (Row)((Row)st.rows[i] << shift);
+            return mask;
+        }
+
+        bool fits(const Mask &mask) const {
+            if (!mask.inBounds) return false;
+            for (int i = 0; i < mask.count; i++) {
+                int y = mask.top + i;
+                // Rows above the board never collide
+                if (y >= 0 && (occupancy[y] & mask.rows[i]))
+                    return false;
+            }
+            return true;
+        }
+
         bool canPlace(const Piece &piece) const {
-            vector<Vec2> positions = piece.getWorldPositions();
-            
-            for (const auto &pos : positions) {
-                // Check boundaries
-                if (pos.x < (-0.01f) || pos.x >= BOARD_W) return false;
-                if (pos.y >= BOARD_H) return false;
-                
-                // Check collision with locked blocks
-                if (pos.y >= 0) {
-                    for (const auto &locked : lockedBlocks) {
-                        if (overlaps(pos, locked.position))
-                            return false;
-                    }
-                }
+            PROFILE_SCOPE(ZONE_CAN_PLACE);
+            return fits(buildMask(piece));
+        }
+
+        // canPlace for a bare (type, rotation, x, y), for searches that
+        // never materialize a Piece
+        bool fitsAt(int type, int rotation, int x, int y) const {
+            const RotationState &st = ROTATION_TABLE.states[type][rotation];
+            if (x + st.minX < 0 || x + st.maxX >= W || y + st.maxY >= H)
+                return false;
+            int shift = x + st.minX;
+            int top = y + st.minY;
+            for (int i = 0; i <= st.maxY - st.minY; i++) {
+                int row = top + i;
+                if (row >= 0 && (occupancy[row] & (Row)((Row)st.rows[i] << shift)))
+                    return false;
             }
             return true;
         }
 
-        void lockPiece(const Piece &piece) {
-            vector<Vec2> positions = piece.getWorldPositions();
-            
-            for (const auto &pos : positions) {
-                if (pos.y >= 0 && pos.y < BOARD_H && pos.x >= (-0.01f) && pos.x < BOARD_W) {
-                    lockedBlocks.push_back(LockedBlock(pos, piece.colorIndex));
+        // Rows the piece can fall before landing. Uses the cached column
+        // surfaces when the piece is above them in every column it covers,
+        // and only walks row by row when it has been tucked under an overhang.
+        int dropDistance(const Piece &piece) const {
+            const RotationState &st = piece.state();
+            int distance = H;
+            for (int i = 0; i <= st.maxX - st.minX; i++) {
+                int x = piece.x + st.minX + i;
+                int bottom = piece.y + st.columnBottom[i];
+                if (bottom >= columnTop[x]) {
+                    distance = -1;
+                    break;
                 }
+                distance = min(distance, columnTop[x] - bottom - 1);
+            }
+            if (distance >= 0)
+                return distance;
+
+            Mask mask = buildMask(piece);
+            distance = 0;
+            while (true) {
+                mask.top++;
+                if (mask.top + mask.count > H || !fits(mask))
+                    return distance;
+                distance++;
             }
         }
 
-        int clearLines() {
-            vector<float> yPositions;
-            
-            // Collect all unique Y positions
-            for (const auto &block : lockedBlocks) {
-                float y = round(block.position.y);
-                bool found = false;
-                for (float yPos : yPositions) {
-                    if (fabs(yPos - y) < 0.1f) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found) yPositions.push_back(y);
+        // The hash this board would have after lockPiece(piece), for a piece
+        // that fits, without touching it. Returns false when the lock would clear a line or
+        // leave cells above the board; only a real lock can tell then.
+        bool hashAfterLock(const Piece &piece, uint64_t &out) const {
+            const RotationState &st = piece.state();
+            int shift = piece.x + st.minX;
+            for (int i = 0; i <= st.maxY - st.minY; i++) {
+                int row = piece.y + st.minY + i;
+                if (row < 0 || (Row)(occupancy[row] | ((Row)st.rows[i] << shift)) == FULL_ROW)
+                    return false;
             }
-            
-            // Check which lines are full
-            vector<float> fullLines;
-            for (float y : yPositions) {
-                int count = 0;
-                for (const auto &block : lockedBlocks) {
-                    if (fabs(block.position.y - y) < 0.5f)
-                        count++;
-                }
-                if (count >= BOARD_W) {
-                    fullLines.push_back(y);
-                }
+            uint64_t h = hash;
+            for (int i = 0; i < PIECE_BLOCKS; i++) {
+                Cell c = piece.cell(i);
+                h ^= CELL_KEYS<W, H>.cells[c.y][c.x];
             }
-            
-            // Remove full lines and shift blocks down
-            if (!fullLines.empty()) {
-                vector<LockedBlock> newBlocks;
-                
-                for (auto &block : lockedBlocks) {
-                    bool inFullLine = false;
-                    for (float y : fullLines) {
-                        if (fabs(block.position.y - y) < 0.5f) {
-                            inFullLine = true;
-                            break;
-                        }
-                    }
-                    
-                    if (!inFullLine) {
-                        // Count how many full lines are below this block
-                        float shift = 0;
-                        for (float y : fullLines) {
-                            if (y > block.position.y)
-                                shift += 1.0f;
-                        }
-                        
-                        LockedBlock newBlock = block;
-                        newBlock.position.y += shift;
-                        newBlocks.push_back(newBlock);
+            out = h;
+            return true;
+        }
+
+        void lockPiece(const Piece &piece) {
+            for (int i = 0; i < PIECE_BLOCKS; i++) {
+                Cell c = piece.cell(i);
+                if (c.y >= 0 && c.y < H && c.x >= 0 && c.x < W) {
+                    occupancy[c.y] |= (Row)((Row)1 << c.x);
+                    colors[c.y][c.x >> 1] |= (uint8_t)((piece.colorIndex & 0xF) << ((c.x & 1) * 4));
+                    hash ^= CELL_KEYS<W, H>.cells[c.y][c.x];
+                    if (c.y < columnTop[c.x]) {
+                        int covered = columnTop[c.x] - c.y - 1;
+                        columnHoles[c.x] += (uint8_t)covered;
+                        totalHoles += covered;
+                        columnTop[c.x] = (uint8_t)c.y;
+                    } else {
+                        // Filled a hole underneath the surface
+                        columnHoles[c.x]--;
+                        totalHoles--;
                     }
+                    if (c.y < touchedTop) touchedTop = c.y;
+                    if (c.y > touchedBottom) touchedBottom = c.y;
                 }
-                
-                lockedBlocks = newBlocks;
-                
-                int lines = fullLines.size();
-                int points = (lines == 1) ? 100 : (lines == 2) ? 300 : (lines == 3) ? 500 : 800;
-                score += points;
-                if (score > highScore)
-                    highScore = score;
-                linesClearedTotal += lines;
-                
-                return lines;
             }
-            
-            return 0;
+            revision++;
+        }
+
+        // Only rows touched by the last lock can have become full. Surviving
+        // rows in that band are compacted downwards one by one, then every
+        // row above the band slides down in a single move.
+        int clearLines() {
+            PROFILE_SCOPE(ZONE_CLEAR_LINES);
+            int top = touchedTop;
+            int bottom = touchedBottom;
+            clearTouched();
+
+            int lines = 0;
+            for (int y = top; y <= bottom; y++) {
+                if (occupancy[y] == FULL_ROW)
+                    lines++;
+            }
+            if (lines == 0)
+                return 0;
+
+            // Every row down to the band may move: hash them out and back in
+            for (int y = 0; y <= bottom; y++)
+                hash ^= rowHash(y, occupancy[y]);
+            int dst = bottom;
+            for (int src = bottom; src >= top; src--) {
+                if (occupancy[src] == FULL_ROW) continue;
+                if (dst != src) moveRows(dst, src, 1);
+                dst--;
+            }
+            moveRows(lines, 0, top);
+            memset(occupancy, 0, lines * sizeof(Row));
+            memset(colors, 0, lines * sizeof(colors[0]));
+            for (int y = lines; y <= bottom; y++)
+                hash ^= rowHash(y, occupancy[y]);
+            recomputeColumns();
+            revision++;
+
+            int points = (lines == 1) ? 100 : (lines == 2) ? 300 : (lines == 3) ? 500 : 800;
+            score += points;
+            if (score > highScore)
+                highScore = score;
+            linesClearedTotal += lines;
+
+            return lines;
         }
 
-        const vector<LockedBlock>& getLockedBlocks() const { return lockedBlocks; }
+        Row getRow(int y) const { return occupancy[y]; }
+        int getCell(int x, int y) const { return colorAt(colors[y], x); }
+        // Packed colours of row y, read with colorAt
+        const uint8_t *getColorRow(int y) const { return colors[y]; }
+        uint32_t getRevision() const { return revision; }
+        uint64_t getHash() const { return hash; }
+        const Row *getRows() const { return occupancy; }
+
+        // Cached surface features, kept current by lockPiece and clearLines
+        int getColumnHeight(int x) const { return H - columnTop[x]; }
+        int getColumnHoles(int x) const { return columnHoles[x]; }
+        int getTotalHoles() const { return totalHoles; }
+        int getMaxHeight() const {
+            int top = H;
+            for (int x = 0; x < W; x++)
+                top = min(top, (int)columnTop[x]);
+            return H - top;
+        }
+        int getAggregateHeight() const {
+            int sum = 0;
+            for (int x = 0; x < W; x++)
+                sum += H - columnTop[x];
+            return sum;
+        }
+        int getBumpiness() const {
+            int sum = 0;
+            for (int x = 0; x + 1 < W; x++)
+                sum += abs((int)columnTop[x] - (int)columnTop[x + 1]);
+            return sum;
+        }
         int getScore() const { return score; }
         int getHighScore() const { return highScore; }
         int getLinesClearedTotal() const { return linesClearedTotal; }
         bool isGameOver() const { return gameOver; }
         void setGameOver(bool value) { gameOver = value; }
     };
-}
-
-// ============================================================================
-// TEXT MODULE
-// ============================================================================
-
-namespace BlockFont {
 
-    using Math::Vec2;
-
-    // M?i k t? l list cc cell (x,y)
-    using Glyph = std::vector<Vec2>;
-
-    std::map<char, Glyph> font;
-
-    void init() {
-        using Math::Vec2;
-
-        font['G'] = {
-		    {1,6},{2,6},{3,6},{4,6},
-		    {0,5},{0,4},{0,3},{0,2},{0,1},
-		    {1,0},{2,0},{3,0},{4,0},
-		    {4,3},{4,2},{4,1},{3,3},{2,3}
-		};
-		
-		// Ch? A
-		font['A'] = {
-		    {1,6},{2,6},{3,6},{4,6},
-		    {0,5},{5,5},
-		    {0,4},{5,4},
-		    {0,3},{1,3},{2,3},{3,3},{4,3},{5,3},
-		    {0,2},{5,2},
-		    {0,1},{5,1},
-		    {0,0},{5,0}
-		};
-		
-		// Ch? M
-		font['M'] = {
-		    {0,0},{0,1},{0,2},{0,3},{0,4},{0,5},{0,6},
-		    {6,0},{6,1},{6,2},{6,3},{6,4},{6,5},{6,6},
-		    {1,4},{2,3},{3,2},{4,3},{5,4}
-		};
-		
-		// Ch? E
-		font['E'] = {
-		    {0,0},{1,0},{2,0},{3,0},{4,0},{5,0},{6,0},
-		    {0,1},{0,2},{0,3},{0,4},{0,5},{0,6},
-		    {1,3},{2,3},{3,3},{4,3},{5,3},
-		    {1,6},{2,6},{3,6},{4,6},{5,6}
-		};
-		
-		// Ch? O
-		font['O'] = {
-		    {1,6},{2,6},{3,6},{4,6},{5,6},
-		    {0,5},{0,4},{0,3},{0,2},{0,1},
-		    {6,5},{6,4},{6,3},{6,2},{6,1},
-		    {1,0},{2,0},{3,0},{4,0},{5,0}
-		};
-		
-		// Ch? V
-		font['V'] = {
-		    {0,6},{0,5},{0,4},{0,3},
-		    {6,6},{6,5},{6,4},{6,3},
-		    {1,2},{2,1},{3,0},{4,1},{5,2}
-		};
-		
-		// Ch? R
-		font['R'] = {
-		    {0,0},{0,1},{0,2},{0,3},{0,4},{0,5},{0,6},
-		    {1,6},{2,6},{3,6},{4,5},{4,4},{4,3},
-		    {1,3},{2,3},{3,3},
-		    {5,2},{6,1},{6,0}
-		};
-    }
+    typedef BasicBoard<BOARD_W, BOARD_H> GameBoard;
+    typedef GameBoard::Row RowMask;
+    typedef GameBoard::Mask PieceMask;
+    typedef GameBoard::State BoardState;
+    const RowMask FULL_ROW = GameBoard::FULL_ROW;
+    const int COLOR_ROW_BYTES = GameBoard::COLOR_BYTES;
 }
 
 // ============================================================================
-// RENDERER MODULE
+// GAME ENGINE MODULE (Headless Core)
 // ============================================================================
 
-namespace Renderer {
+namespace GameEngine {
     using namespace Config;
-    using namespace Color;
     using namespace Tetromino;
     using namespace Board;
     using namespace Math;
 
-    class GameRenderer {
-    private:
-        GameBoard *board;
-        Piece *currentPiece;
-        Piece *nextPiece;
+    // Input bits accepted by Game::step, applied in this order
+    enum Input : unsigned {
+        INPUT_NONE      = 0,
+        INPUT_RESTART   = 1u << 0,
+        INPUT_LEFT      = 1u << 1,
+        INPUT_RIGHT     = 1u << 2,
+        INPUT_ROTATE    = 1u << 3,
+        INPUT_SOFT_DROP = 1u << 4,
+        INPUT_HARD_DROP = 1u << 5
+    };
+
+    // Snapshot of a whole Game: board, both pieces, generator position and
+    // timers. Flat and fixed-size, so it can be kept in arrays, memcpy'd or
+    // sent over the wire as is.
+    template <class BoardT>
+    struct BasicGameState {
+        typename BoardT::State board;
+        PieceFactory::State factory;
+        Piece currentPiece;
+        Piece nextPiece;
+        int64_t gravityElapsedUs;
+        int64_t piecesPlaced;
+        float dropInterval;
+    };
 
+    // Pure simulation: no GL, no globals. Time advances only through step()
+    // in integer microseconds so identical input streams give identical games.
+    // BoardT is any BasicBoard; Game below is the standard 10x20 one.
+    template <class BoardT>
+    class BasicGame {
     public:
-        GameRenderer(GameBoard *b, Piece *curr, Piece *next) 
-            : board(b), currentPiece(curr), nextPiece(next) {}
+        typedef BoardT BoardType;
+        typedef BasicGameState<BoardT> State;
 
-        void drawBlockAt(const Vec2& worldPos, int colorIdx) const {
-            const float pad = 1.5f;
-            float x = worldPos.x * CELL;
-            float y = (BOARD_H - worldPos.y) * CELL;
-
-            setGLColor(colorIdx);
-            glBegin(GL_QUADS);
-            glVertex2f(x + pad, y - CELL + pad);
-            glVertex2f(x + CELL - pad, y - CELL + pad);
-            glVertex2f(x + CELL - pad, y - pad);
-            glVertex2f(x + pad, y - pad);
-            glEnd();
+    private:
+        BoardT board;
+        Piece currentPiece;
+        Piece nextPiece;
+        PieceFactory factory;
+        float dropInterval;
+        int64_t gravityElapsedUs;
+        long piecesPlaced;
 
-            glColor3f(0.1f, 0.1f, 0.1f);
-            glBegin(GL_LINE_LOOP);
-            glVertex2f(x + pad, y - CELL + pad);
-            glVertex2f(x + CELL - pad, y - CELL + pad);
-            glVertex2f(x + CELL - pad, y - pad);
-            glVertex2f(x + pad, y - pad);
-            glEnd();
+    public:
+        explicit BasicGame(uint64_t seed = 0, Randomizer mode = RANDOMIZER_UNIFORM)
+            : factory(seed, mode), dropInterval(DEFAULT_DROP_INTERVAL), gravityElapsedUs(0), piecesPlaced(0) {
+            nextPiece = factory.createRandomPiece();
+            spawnPiece();
         }
 
-        void drawBoard() const {
-            // Background
-            glColor3f(0.05f, 0.05f, 0.05f);
-            glBegin(GL_QUADS);
-            glVertex2f(0, 0);
-            glVertex2f(BOARD_W * CELL, 0);
-            glVertex2f(BOARD_W * CELL, BOARD_H * CELL);
-            glVertex2f(0, BOARD_H * CELL);
-            glEnd();
-
-            // Grid lines
-            glColor3f(0.15f, 0.15f, 0.15f);
-            for (int i = 0; i <= BOARD_W; i++) {
-                glBegin(GL_LINES);
-                glVertex2f(i * CELL, 0);
-                glVertex2f(i * CELL, BOARD_H * CELL);
-                glEnd();
-            }
-            for (int i = 0; i <= BOARD_H; i++) {
-                glBegin(GL_LINES);
-                glVertex2f(0, i * CELL);
-                glVertex2f(BOARD_W * CELL, i * CELL);
-                glEnd();
-            }
-
-            // Locked blocks
-            for (const auto &block : board->getLockedBlocks()) {
-                if (block.position.y >= 0 && block.position.y < BOARD_H)
-                    drawBlockAt(block.position, block.color);
-            }
-
-            // Current piece
-            vector<Vec2> positions = currentPiece->getWorldPositions();
-            for (const auto &pos : positions) {
-                if (pos.y >= 0 && pos.y < BOARD_H && pos.x >= (-0.01f)&& pos.x < BOARD_W)
-                    drawBlockAt(pos, currentPiece->colorIndex);
-            }
+        // Starts a fresh game whose piece sequence depends only on seed
+        void reset(uint64_t seed) {
+            reset(seed, factory.getMode());
         }
 
-        void drawText(float x, float y, const string &s) const {
-            glRasterPos2f(x, y);
-            for (char ch : s)
-                glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, ch);
-        }
-
-		static void drawBlockGlyph(char c, const Math::Mat3 &M, float cellSize) {
-		    using namespace Math;
-		
-		    auto it = BlockFont::font.find(c);
-		    if (it == BlockFont::font.end()) return;
-		
-		    for (auto cell : it->second) {
-		        // T?a d? g?c cell
-		        Vec2 p(cell.x * cellSize, cell.y * cellSize);
-		
-		        // p ma tr?n vo t?ng cell
-		        Vec2 t = applyMat3(M, p);
-		
-		        // V? block (gi?ng block tetromino)
-		        glBegin(GL_QUADS);
-		        glVertex2f(t.x,           t.y);
-		        glVertex2f(t.x+cellSize,  t.y);
-		        glVertex2f(t.x+cellSize,  t.y+cellSize);
-		        glVertex2f(t.x,           t.y+cellSize);
-		        glEnd();
-		    }
-		}
-	    static void drawTextGAMEOVER(float x, float y, float animScale) {
-		    using namespace Math;
-		
-		    string line1 = "GAME";
-		    string line2 = "OVER";
-		    float cell = 10.0f;
-		    float spacing = 70.0f;
-		    float lineSpacing = 80.0f; // Kho?ng cch gi?a hai hng
-		
-		    // V? dng 1
-		    float cx = x;
-		    for (char c : line1) {
-		        Mat3 T = matTranslate(cx, y);
-		        Mat3 S = matScale(animScale, animScale);
-		        Mat3 M = matMul(T, S);
-		
-		        drawBlockGlyph(c, M, cell);
-		        cx += spacing;
-		    }
-		
-		    // V? dng 2
-		    cx = x;
-		    float y2 = y - lineSpacing; // H? dng 2 xu?ng
-		    for (char c : line2) {
-		        Mat3 T = matTranslate(cx, y2);
-		        Mat3 S = matScale(animScale, animScale);
-		        Mat3 M = matMul(T, S);
-		
-		        drawBlockGlyph(c, M, cell);
-		        cx += spacing;
-		    }
-		}
-
-
-        void drawSidePanel() const {
-            float panelX = BOARD_W * CELL + PANEL_X_OFFSET;
-            float yPos = WINDOW_H - 20;
-
-            // Next piece section
-            glColor3f(1, 1, 1);
-            drawText(panelX, yPos, "Next:");
-            yPos -= 30;
-
-            for (const auto &block : nextPiece->blocks) {
-                Vec2 localPos = block.localPos;
-                float x = panelX + 20 + (localPos.x + 1.5f) * PANEL_PREVIEW_SCALE;
-                float y = yPos - (localPos.y + 1.5f) * PANEL_PREVIEW_SCALE;
-
-                setGLColor(nextPiece->colorIndex);
-                glBegin(GL_QUADS);
-                glVertex2f(x, y);
-                glVertex2f(x + PANEL_PREVIEW_SCALE - 2, y);
-                glVertex2f(x + PANEL_PREVIEW_SCALE - 2, y + PANEL_PREVIEW_SCALE - 2);
-                glVertex2f(x, y + PANEL_PREVIEW_SCALE - 2);
-                glEnd();
-            }
+        void reset(uint64_t seed, Randomizer mode) {
+            factory.reseed(seed, mode);
+            gravityElapsedUs = 0;
+            piecesPlaced = 0;
+            restart();
+        }
 
-            // Score section
-            yPos -= 100;
-            glColor3f(1, 1, 1);
-            drawText(panelX, yPos, "Score: " + to_string(board->getScore()));
-            drawText(panelX, yPos - 20, "High: " + to_string(board->getHighScore()));
-            drawText(panelX, yPos - 40, "Lines: " + to_string(board->getLinesClearedTotal()));
-
-            // Controls section
-            yPos -= 80;
-            glColor3f(0.7f, 0.7f, 0.7f);
-            drawText(panelX, yPos, "Controls:");
-            drawText(panelX, yPos - 20, "Arrows: Move");
-            drawText(panelX, yPos - 40, "Up: Rotate");
-            drawText(panelX, yPos - 60, "Space: Drop");
-            drawText(panelX, yPos - 80, "R: Restart");
+        void step(unsigned inputs, int64_t dtUs) {
+            PROFILE_SCOPE(ZONE_GAME_STEP);
+            if (inputs & INPUT_RESTART)   restart();
+            if (inputs & INPUT_LEFT)      tryMove(-1, 0);
+            if (inputs & INPUT_RIGHT)     tryMove(1, 0);
+            if (inputs & INPUT_ROTATE)    tryRotate();
+            if (inputs & INPUT_SOFT_DROP) softDrop();
+            if (inputs & INPUT_HARD_DROP) hardDrop();
 
-            // Game over
-            if (board->isGameOver()) {
-               	float t = glutGet(GLUT_ELAPSED_TIME) / 1000.0f;
-			    float scale = 1.0f + 0.3f * sinf(t * 4.0f);
-			
-			    glColor3f(1, 0, 0);
-			    drawTextGAMEOVER(40, Config::WINDOW_H / 2, scale);
+            // Gravity: one soft drop per elapsed drop interval. The remainder
+            // carries over in whole microseconds, so one long dt spanning
+            // several intervals drops exactly as often as the same time split
+            // into ticks (replays rely on that to skip empty ticks in one step).
+            gravityElapsedUs += dtUs;
+            while (gravityElapsedUs >= gravityIntervalUs()) {
+                gravityElapsedUs -= gravityIntervalUs();
+                softDrop();
             }
         }
 
-        void render() const {
-            glClear(GL_COLOR_BUFFER_BIT);
-            drawBoard();
-            drawSidePanel();
-            glutSwapBuffers();
-        }
-    };
-}
-
-// ============================================================================
-// GAME ENGINE MODULE
-// ============================================================================
-
-namespace GameEngine {
-    using namespace Config;
-    using namespace Tetromino;
-    using namespace Board;
-    using namespace Renderer;
-    using namespace Math;
-
-    class Game {
-    private:
-        GameBoard board;
-        Piece currentPiece;
-        Piece nextPiece;
-        PieceFactory factory;
-        GameRenderer renderer;
-        float dropInterval;
+        int64_t gravityIntervalUs() const { return (int64_t)(dropInterval * 1000.0f); }
 
-    public:
-        Game() : renderer(&board, &currentPiece, &nextPiece), 
-                 dropInterval(DEFAULT_DROP_INTERVAL) {
-            nextPiece = factory.createRandomPiece();
-            spawnPiece();
+        // Every piece enters in its base rotation at the top centre
+        static void moveToSpawn(Piece &piece) {
+            piece.rotation = 0;
+            piece.x = BoardT::WIDTH / 2;
+            piece.y = 1;
         }
 
         void spawnPiece() {
-            // Use nextPiece if it has blocks, otherwise create new piece
-            if (nextPiece.blocks.empty()) {
+            // Use nextPiece if it is set, otherwise create new piece
+            if (nextPiece.isEmpty()) {
                 currentPiece = factory.createRandomPiece();
             } else {
                 currentPiece = nextPiece;
             }
-            
-            currentPiece.transform = matIdentity();
-            currentPiece.translate(BOARD_W / 2.0f, 1.0f);
+
+            moveToSpawn(currentPiece);
 
             nextPiece = factory.createRandomPiece();
-            nextPiece.transform = matIdentity();
 
             if (!board.canPlace(currentPiece)) {
                 board.setGameOver(true);
             }
         }
 
-        bool tryMove(float dx, float dy) {
+        bool tryMove(int dx, int dy) {
             Piece testPiece = currentPiece;
             testPiece.translate(dx, dy);
 
@@ -807,7 +1337,7 @@ namespace GameEngine {
 
         bool tryRotate() {
             Piece testPiece = currentPiece;
-            testPiece.rotate(90.0f);
+            testPiece.rotate();
 
             if (board.canPlace(testPiece)) {
                 currentPiece = testPiece;
@@ -815,8 +1345,7 @@ namespace GameEngine {
             }
 
             // Wall kick
-            const float kicks[] = {-1, 1, -2, 2};
-            for (float k : kicks) {
+            for (int k : WALL_KICKS) {
                 Piece kickPiece = testPiece;
                 kickPiece.translate(k, 0);
 
@@ -837,139 +1366,5180 @@ namespace GameEngine {
             if (board.canPlace(testPiece)) {
                 currentPiece = testPiece;
             } else {
-                board.lockPiece(currentPiece);
-                board.clearLines();
-                spawnPiece();
+                lockCurrentPiece();
             }
         }
 
         void hardDrop() {
             if (board.isGameOver()) return;
 
-            while (true) {
-                Piece testPiece = currentPiece;
-                testPiece.translate(0, 1);
+            currentPiece.translate(0, board.dropDistance(currentPiece));
+            lockCurrentPiece();
+        }
 
-                if (!board.canPlace(testPiece))
-                    break;
-                currentPiece = testPiece;
-            }
+        void lockCurrentPiece() {
             board.lockPiece(currentPiece);
             board.clearLines();
+            piecesPlaced++;
             spawnPiece();
         }
 
-        void handleKeyLeft() { tryMove(-1, 0); }
-        void handleKeyRight() { tryMove(1, 0); }
-        void handleKeyUp() { tryRotate(); }
-        void handleKeyDown() { softDrop(); }
-        void handleKeySpace() { hardDrop(); }
-        void handleKeyR() {
+        void restart() {
             board.reset();
             nextPiece = factory.createRandomPiece();
             spawnPiece();
         }
 
-        void update() { softDrop(); }
-        void render() { renderer.render(); }
+        void save(State &out) const {
+            board.save(out.board);
+            factory.save(out.factory);
+            out.currentPiece = currentPiece;
+            out.nextPiece = nextPiece;
+            out.gravityElapsedUs = gravityElapsedUs;
+            out.piecesPlaced = piecesPlaced;
+            out.dropInterval = dropInterval;
+        }
+
+        void restore(const State &in) {
+            board.restore(in.board);
+            factory.restore(in.factory);
+            currentPiece = in.currentPiece;
+            nextPiece = in.nextPiece;
+            gravityElapsedUs = in.gravityElapsedUs;
+            piecesPlaced = (long)in.piecesPlaced;
+            dropInterval = in.dropInterval;
+        }
+
+        const BoardT &getBoard() const { return board; }
+        const Piece &getCurrentPiece() const { return currentPiece; }
+        const Piece &getNextPiece() const { return nextPiece; }
         float getDropInterval() const { return dropInterval; }
+        long getPiecesPlaced() const { return piecesPlaced; }
+        // Zobrist hash of the board plus the active piece's pose
+        uint64_t getHash() const { return board.getHash() ^ pieceHash(currentPiece); }
+        uint64_t getSeed() const { return factory.getSeed(); }
+        Randomizer getRandomizer() const { return factory.getMode(); }
         bool isGameOver() const { return board.isGameOver(); }
     };
+
+    typedef BasicGame<GameBoard> Game;
+    typedef Game::State GameState;
+
+    static_assert(is_trivially_copyable<GameState>::value, "GameState must stay a flat copy");
+
+    // The last capacity() game states for multi-level undo; once full, each
+    // push overwrites the oldest. The slots are allocated up front, so push
+    // and pop are one GameState copy each and never touch the heap.
+    class StateHistory {
+    private:
+        vector<GameState> states;
+        int head;                       // Slot the next push writes
+        int count;
+
+    public:
+        explicit StateHistory(int capacity) : states(max(1, capacity)), head(0), count(0) {}
+
+        void push(const Game &game) {
+            game.save(states[head]);
+            head = (head + 1) % capacity();
+            count = min(count + 1, capacity());
+        }
+
+        // Restores the most recent state and drops it from the history
+        bool pop(Game &game) {
+            if (count == 0) return false;
+            head = (head + capacity() - 1) % capacity();
+            count--;
+            game.restore(states[head]);
+            return true;
+        }
+
+        // back = 0 is the most recent state
+        const GameState *peek(int back = 0) const {
+            if (back < 0 || back >= count) return nullptr;
+            return &states[(head + capacity() - 1 - back) % capacity()];
+        }
+
+        void clear() { head = count = 0; }
+        int size() const { return count; }
+        int capacity() const { return (int)states.size(); }
+    };
 }
 
 // ============================================================================
-// GLOBAL GAME INSTANCE
+// SEARCH MODULE (Placement Enumerator)
 // ============================================================================
 
-GameEngine::Game *gameInstance = nullptr;
+namespace Search {
+    using namespace Config;
+    using namespace Tetromino;
+    using namespace Board;
+    using namespace GameEngine;
 
-// ============================================================================
-// GLUT CALLBACKS
-// ============================================================================
+    // A distinct spot where the piece can lock, identified by the pose it
+    // rests in. node is the search state it was reached through (see pathTo).
+    struct Placement {
+        int8_t x, y;
+        int8_t rotation;
+        uint16_t node;
+    };
 
-void display() {
-    if (gameInstance)
-        gameInstance->render();
-}
+    // Breadth-first search over (rotation, y, x) for one piece on one board.
+    // Moves are the ones Game::step applies, in its order: left, right,
+    // rotate (with WALL_KICKS, like Game::tryRotate) and soft drop. Every
+    // state that cannot fall any further is a lock position; positions
+    // covering the same cells (O, I, S, Z symmetries) are reported once, by
+    // the shortest path that reaches them. All storage is fixed-size, so an
+    // enumerator can be reused without allocating.
+    class PlacementEnumerator {
+    public:
+        static const int X_OFFSET = POSE_X_OFFSET;
+        static const int X_RANGE = POSE_X_RANGE;
+        static const int Y_OFFSET = POSE_Y_OFFSET;
+        static const int Y_RANGE = POSE_Y_RANGE;
+        static const int STATE_COUNT = ROTATIONS * Y_RANGE * X_RANGE;
 
-void timerFunc(int value) {
-    if (gameInstance) {
-        gameInstance->update();
-        glutPostRedisplay();
-        glutTimerFunc((int)gameInstance->getDropInterval(), timerFunc, 0);
-    }
-}
+    private:
+        uint64_t visited[(STATE_COUNT + 63) / 64];
+        int16_t parent[STATE_COUNT];
+        uint8_t move[STATE_COUNT];              // Input bit that led to the state
+        uint16_t queue[STATE_COUNT];
+        uint64_t keys[STATE_COUNT];             // Sorted cell indices per placement
+        Placement placements[STATE_COUNT];
+        int placementCount;
+        int statesVisited;
 
-void specialKey(int key, int x, int y) {
-    if (!gameInstance) return;
+        static int encode(int rotation, int x, int y) {
+            return (rotation * Y_RANGE + y + Y_OFFSET) * X_RANGE + x + X_OFFSET;
+        }
 
-    switch (key) {
-    case GLUT_KEY_LEFT:
-        gameInstance->handleKeyLeft();
-        break;
-    case GLUT_KEY_RIGHT:
-        gameInstance->handleKeyRight();
-        break;
-    case GLUT_KEY_DOWN:
-        gameInstance->handleKeyDown();
-        break;
-    case GLUT_KEY_UP:
-        gameInstance->handleKeyUp();
-        break;
-    }
-    glutPostRedisplay();
-}
+        static bool inRange(int x, int y) {
+            return x + X_OFFSET >= 0 && x + X_OFFSET < X_RANGE &&
+                   y + Y_OFFSET >= 0 && y + Y_OFFSET < Y_RANGE;
+        }
 
-void keyboard(unsigned char key, int x, int y) {
-    if (!gameInstance) return;
+        void visit(const GameBoard &board, int type, int rotation, int x, int y,
+                   int from, unsigned input, int &tail) {
+            if (!inRange(x, y)) return;
+            int node = encode(rotation, x, y);
+            uint64_t bit = 1ull << (node & 63);
+            if (visited[node >> 6] & bit) return;
+            if (!board.fitsAt(type, rotation, x, y)) return;
+            visited[node >> 6] |= bit;
+            parent[node] = (int16_t)from;
+            move[node] = (uint8_t)input;
+            queue[tail++] = (uint16_t)node;
+        }
 
-    if (key == 27) exit(0);
-    if (key == ' ') gameInstance->handleKeySpace();
-    if (key == 'r' || key == 'R') gameInstance->handleKeyR();
-    glutPostRedisplay();
-}
+        static uint64_t cellKey(int type, int rotation, int x, int y) {
+            const RotationState &st = ROTATION_TABLE.states[type][rotation];
+            uint16_t c[PIECE_BLOCKS];
+            for (int i = 0; i < PIECE_BLOCKS; i++)
+                c[i] = (uint16_t)((y + st.cells[i].y + 32) * BOARD_W + x + st.cells[i].x);
+            sort(c, c + PIECE_BLOCKS);
+            return (uint64_t)c[0] | (uint64_t)c[1] << 16 | (uint64_t)c[2] << 32 | (uint64_t)c[3] << 48;
+        }
 
-void reshape(int w, int h) {
-    glViewport(0, 0, w, h);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluOrtho2D(0, w, 0, h);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-}
+        void addPlacement(int type, int rotation, int x, int y, int node) {
+            uint64_t key = cellKey(type, rotation, x, y);
+            for (int i = 0; i < placementCount; i++) {
+                if (keys[i] == key) return;
+            }
+            keys[placementCount] = key;
+            placements[placementCount++] = Placement{(int8_t)x, (int8_t)y, (int8_t)rotation, (uint16_t)node};
+        }
 
-void initGL() {
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glShadeModel(GL_FLAT);
+    public:
+        PlacementEnumerator() : placementCount(0), statesVisited(0) {}
+
+        // Returns the number of distinct lock positions reachable from piece
+        int enumerate(const GameBoard &board, const Piece &piece) {
+            placementCount = 0;
+            statesVisited = 0;
+            memset(visited, 0, sizeof(visited));
+            if (piece.isEmpty() || board.isGameOver()) return 0;
+
+            const int type = piece.type;
+            int head = 0, tail = 0;
+            visit(board, type, piece.rotation, piece.x, piece.y, -1, INPUT_NONE, tail);
+
+            while (head < tail) {
+                int node = queue[head++];
+                int x = node % X_RANGE - X_OFFSET;
+                int y = node / X_RANGE % Y_RANGE - Y_OFFSET;
+                int rot = node / (X_RANGE * Y_RANGE);
+
+                visit(board, type, rot, x - 1, y, node, INPUT_LEFT, tail);
+                visit(board, type, rot, x + 1, y, node, INPUT_RIGHT, tail);
+
+                int next = (rot + 1) & (ROTATIONS - 1);
+                if (board.fitsAt(type, next, x, y)) {
+                    visit(board, type, next, x, y, node, INPUT_ROTATE, tail);
+                } else {
+                    for (int k : WALL_KICKS) {
+                        if (board.fitsAt(type, next, x + k, y)) {
+                            visit(board, type, next, x + k, y, node, INPUT_ROTATE, tail);
+                            break;
+                        }
+                    }
+                }
+
+                if (board.fitsAt(type, rot, x, y + 1))
+                    visit(board, type, rot, x, y + 1, node, INPUT_SOFT_DROP, tail);
+                else
+                    addPlacement(type, rot, x, y, node);
+            }
+            statesVisited = tail;
+            return placementCount;
+        }
+
+        // Inputs that take the piece from its start to p and lock it there,
+        // one Game::step per entry. Trailing soft drops are folded into the
+        // final hard drop. Returns the length, or -1 if capacity is too small.
+        int pathTo(const Placement &p, unsigned *out, int capacity) const {
+            int length = 0;
+            for (int n = p.node; parent[n] >= 0; n = parent[n])
+                length++;
+            int end = length;
+            int n = p.node;
+            while (end > 0 && move[n] == INPUT_SOFT_DROP) {
+                n = parent[n];
+                end--;
+            }
+            if (end + 1 > capacity) return -1;
+            for (int i = end - 1; i >= 0; i--) {
+                out[i] = move[n];
+                n = parent[n];
+            }
+            out[end] = INPUT_HARD_DROP;
+            return end + 1;
+        }
+
+        int count() const { return placementCount; }
+        const Placement &get(int i) const { return placements[i]; }
+        int getStatesVisited() const { return statesVisited; }
+    };
+
+    // Fixed-size evaluation cache shared by search threads without locks.
+    // A slot holds key ^ data next to data, each in a relaxed atomic, so a
+    // read racing a write sees a mismatched key and misses instead of
+    // returning the other position's value. Slots are always replaced.
+    class TranspositionTable {
+    public:
+        // Per-thread counters, summed by the owner to size the table
+        struct Stats {
+            long probes = 0;
+            long hits = 0;
+            long stores = 0;
+            long overwrites = 0;        // Stores that evicted another position
+
+            void add(const Stats &other) {
+                probes += other.probes;
+                hits += other.hits;
+                stores += other.stores;
+                overwrites += other.overwrites;
+            }
+
+            double hitRate() const { return probes ? (double)hits / probes : 0.0; }
+        };
+
+    private:
+        struct Entry {
+            atomic<uint64_t> check;
+            atomic<uint64_t> data;      // Value bits, VALID flag above them
+        };
+
+        static const uint64_t VALID = 1ull << 32;
+
+        unique_ptr<Entry[]> entries;
+        uint64_t mask;
+
+    public:
+        explicit TranspositionTable(int bits) : entries(new Entry[size_t(1) << bits]), mask((uint64_t(1) << bits) - 1) {
+            clear();
+        }
+
+        void clear() {
+            for (uint64_t i = 0; i <= mask; i++) {
+                entries[i].check.store(0, memory_order_relaxed);
+                entries[i].data.store(0, memory_order_relaxed);
+            }
+        }
+
+        bool probe(uint64_t key, float &value, Stats &stats) const {
+            const Entry &e = entries[key & mask];
+            uint64_t data = e.data.load(memory_order_relaxed);
+            uint64_t check = e.check.load(memory_order_relaxed);
+            stats.probes++;
+            if (!(data & VALID) || (check ^ data) != key) return false;
+            uint32_t bits = (uint32_t)data;
+            memcpy(&value, &bits, sizeof(value));
+            stats.hits++;
+            return true;
+        }
+
+        void store(uint64_t key, float value, Stats &stats) {
+            Entry &e = entries[key & mask];
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            uint64_t data = VALID | bits;
+            uint64_t old = e.data.load(memory_order_relaxed);
+            if ((old & VALID) && (e.check.load(memory_order_relaxed) ^ old) != key)
+                stats.overwrites++;
+            e.check.store(key ^ data, memory_order_relaxed);
+            e.data.store(data, memory_order_relaxed);
+            stats.stores++;
+        }
+
+        // Share of filled slots, estimated from the first few thousand
+        double occupancy() const {
+            uint64_t sample = min<uint64_t>(mask + 1, 4096), used = 0;
+            for (uint64_t i = 0; i < sample; i++)
+                used += (entries[i].data.load(memory_order_relaxed) & VALID) != 0;
+            return (double)used / sample;
+        }
+
+        size_t size() const { return (size_t)mask + 1; }
+        size_t bytes() const { return size() * sizeof(Entry); }
+    };
 }
 
 // ============================================================================
-// MAIN
+// SIMULATION MODULE (Batched Boards, Struct-of-Arrays)
 // ============================================================================
 
-int main(int argc, char **argv) {
-    srand((unsigned)time(nullptr));
+namespace Simulation {
+    using namespace Config;
+    using namespace Tetromino;
+    using namespace Board;
 
-    gameInstance = new GameEngine::Game();
+    // One action per board per stepAll call
+    enum BatchAction : uint8_t {
+        ACTION_NONE = 0,
+        ACTION_LEFT,
+        ACTION_RIGHT,
+        ACTION_ROTATE,
+        ACTION_SOFT_DROP,
+        ACTION_HARD_DROP
+    };
 
-    glutInit(&argc, argv);
-    BlockFont::init();
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
-    glutInitWindowSize(Config::WINDOW_W, Config::WINDOW_H);
-    glutInitWindowPosition(100, 100);
-    glutCreateWindow("Tetris - Pure Matrix Transform (No Grid)");
+    // N independent boards advanced in lockstep with the same rules as
+    // Game::step (move/rotate with kicks, then soft drop, hard drop and
+    // gravity, lockPiece + clearLines + spawn). Every field is a contiguous
+    // array indexed by board and rows are interleaved across boards
+    // (rows[y * count + b]), so each phase of stepAll is a flat loop.
+    class BoardBatch {
+    private:
+        int count;
+        int gravityPeriod;              // stepAll calls per gravity drop
 
-    initGL();
+        vector<RowMask> rows;
+        vector<int8_t> type, rotation, posX, posY, nextType;
+        vector<int8_t> candX, candRot;
+        vector<uint8_t> drops;
+        vector<uint16_t> gravityTimer;
+        vector<int32_t> score, highScore, lines, pieces;
+        vector<uint8_t> gameOver;
+        vector<uint32_t> rng0, rng1, rng2, rng3;
 
-    glutDisplayFunc(display);
-    glutReshapeFunc(reshape);
-    glutKeyboardFunc(keyboard);
-    glutSpecialFunc(specialKey);
-    glutTimerFunc((int)gameInstance->getDropInterval(), timerFunc, 0);
+        int randomType(int b) {
+            uint32_t r = Random::xoshiroNext(rng0[b], rng1[b], rng2[b], rng3[b]);
+            return (int)Random::reduce(r, PIECE_COUNT);
+        }
 
-    glutMainLoop();
+        bool fits(int b, int t, int rot, int x, int y) const {
+            const RotationState &st = ROTATION_TABLE.states[t][rot];
+            if (x + st.minX < 0 || x + st.maxX >= BOARD_W || y + st.maxY >= BOARD_H)
+                return false;
+            int shift = x + st.minX;
+            int top = y + st.minY;
+            for (int i = 0; i <= st.maxY - st.minY; i++) {
+                int row = top + i;
+                // Rows above the board never collide
+                if (row >= 0 && (rows[row * count + b] & (RowMask)(st.rows[i] << shift)))
+                    return false;
+            }
+            return true;
+        }
 
-    delete gameInstance;
-    return 0;
-}
+        void spawn(int b) {
+            type[b] = nextType[b];
+            rotation[b] = 0;
+            posX[b] = BOARD_W / 2;
+            posY[b] = 1;
+            nextType[b] = (int8_t)randomType(b);
+            if (!fits(b, type[b], 0, posX[b], posY[b]))
+                gameOver[b] = 1;
+        }
+
+        void lockAndSpawn(int b) {
+            const RotationState &st = ROTATION_TABLE.states[type[b]][rotation[b]];
+            int top = BOARD_H, bottom = -1;
+            for (int i = 0; i < PIECE_BLOCKS; i++) {
+                int x = posX[b] + st.cells[i].x;
+                int y = posY[b] + st.cells[i].y;
+                if (y < 0 || y >= BOARD_H || x < 0 || x >= BOARD_W) continue;
+                rows[y * count + b] |= (RowMask)(1u << x);
+                if (y < top) top = y;
+                if (y > bottom) bottom = y;
+            }
+
+            int cleared = 0;
+            for (int y = top; y <= bottom; y++) {
+                if (rows[y * count + b] == FULL_ROW)
+                    cleared++;
+            }
+            if (cleared) {
+                int dst = bottom;
+                for (int src = bottom; src >= 0; src--) {
+                    RowMask row = rows[src * count + b];
+                    if (src >= top && row == FULL_ROW) continue;
+                    rows[dst * count + b] = row;
+                    dst--;
+                }
+                for (; dst >= 0; dst--)
+                    rows[dst * count + b] = 0;
+
+                score[b] += (cleared == 1) ? 100 : (cleared == 2) ? 300 : (cleared == 3) ? 500 : 800;
+                if (score[b] > highScore[b])
+                    highScore[b] = score[b];
+                lines[b] += cleared;
+            }
+
+            pieces[b]++;
+            spawn(b);
+        }
+
+    public:
+        BoardBatch(int n, uint64_t seed, int gravitySteps = 30)
+            : count(n), gravityPeriod(gravitySteps),
+              rows((size_t)n * BOARD_H, 0),
+              type(n), rotation(n), posX(n), posY(n), nextType(n),
+              candX(n), candRot(n), drops(n), gravityTimer(n, 0),
+              score(n, 0), highScore(n, 0), lines(n, 0), pieces(n, 0), gameOver(n, 0),
+              rng0(n), rng1(n), rng2(n), rng3(n) {
+            for (int b = 0; b < n; b++) {
+                Random::Xoshiro128 rng(Random::splitMix64(seed));
+                rng0[b] = rng.s[0];
+                rng1[b] = rng.s[1];
+                rng2[b] = rng.s[2];
+                rng3[b] = rng.s[3];
+                reset(b);
+            }
+        }
+
+        // Storage for the whole batch; every array is one entry (or one
+        // column of rows) per board
+        size_t getBytes() const {
+            size_t bytes = rows.size() * sizeof(RowMask) + gravityTimer.size() * sizeof(uint16_t);
+            for (const vector<int8_t> *v : {&type, &rotation, &posX, &posY, &nextType, &candX, &candRot})
+                bytes += v->size();
+            bytes += drops.size() + gameOver.size();
+            for (const vector<int32_t> *v : {&score, &highScore, &lines, &pieces})
+                bytes += v->size() * sizeof(int32_t);
+            for (const vector<uint32_t> *v : {&rng0, &rng1, &rng2, &rng3})
+                bytes += v->size() * sizeof(uint32_t);
+            return bytes;
+        }
+
+        // Same as Game::restart: empty board, fresh preview, high score kept
+        void reset(int b) {
+            for (int y = 0; y < BOARD_H; y++)
+                rows[y * count + b] = 0;
+            score[b] = 0;
+            lines[b] = 0;
+            pieces[b] = 0;
+            gameOver[b] = 0;
+            nextType[b] = (int8_t)randomType(b);
+            spawn(b);
+        }
+
+        void stepAll(const uint8_t *actions) {
+            const int n = count;
+
+            // Phases 1 and 3 go through local restrict pointers: a byte store
+            // through a vector's element may alias the vector's own data
+            // pointer, and reloading it every iteration keeps GCC from
+            // vectorizing. The pointers are scoped to their phase because
+            // phases 2 and 4 reach the same arrays through fits() and
+            // lockAndSpawn().
+
+            // Phase 1: candidate column and rotation for every board
+            {
+                const uint8_t *__restrict act = actions;
+                const int8_t *__restrict x = posX.data();
+                const int8_t *__restrict rot = rotation.data();
+                int8_t *__restrict cx = candX.data();
+                int8_t *__restrict crot = candRot.data();
+                for (int b = 0; b < n; b++) {
+                    uint8_t a = act[b];
+                    cx[b] = (int8_t)(x[b] + (a == ACTION_RIGHT) - (a == ACTION_LEFT));
+                    crot[b] = (int8_t)((rot[b] + (a == ACTION_ROTATE)) & (ROTATIONS - 1));
+                }
+            }
+
+            // Phase 2: accept moves and rotations, kicks in tryRotate order
+            for (int b = 0; b < n; b++) {
+                uint8_t a = actions[b];
+                if (gameOver[b] || a < ACTION_LEFT || a > ACTION_ROTATE) continue;
+                if (fits(b, type[b], candRot[b], candX[b], posY[b])) {
+                    posX[b] = candX[b];
+                    rotation[b] = candRot[b];
+                } else if (a == ACTION_ROTATE) {
+                    for (int k : WALL_KICKS) {
+                        if (fits(b, type[b], candRot[b], candX[b] + k, posY[b])) {
+                            posX[b] = (int8_t)(candX[b] + k);
+                            rotation[b] = candRot[b];
+                            break;
+                        }
+                    }
+                }
+            }
+
+            // Phase 3: gravity timers and the number of one-row drops
+            {
+                const uint8_t *__restrict act = actions;
+                uint16_t *__restrict timer = gravityTimer.data();
+                uint8_t *__restrict drop = drops.data();
+                const int period = gravityPeriod;
+                for (int b = 0; b < n; b++) {
+                    uint16_t t = (uint16_t)(timer[b] + 1);
+                    uint8_t due = t >= period;
+                    timer[b] = due ? 0 : t;
+                    drop[b] = (uint8_t)(due + (act[b] == ACTION_SOFT_DROP));
+                }
+            }
+
+            // Phase 4: hard drops, soft drops, locks, line clears and spawns
+            for (int b = 0; b < n; b++) {
+                if (gameOver[b]) continue;
+                if (actions[b] == ACTION_HARD_DROP) {
+                    while (fits(b, type[b], rotation[b], posX[b], posY[b] + 1))
+                        posY[b]++;
+                    lockAndSpawn(b);
+                }
+                for (int d = 0; d < drops[b] && !gameOver[b]; d++) {
+                    if (fits(b, type[b], rotation[b], posX[b], posY[b] + 1))
+                        posY[b]++;
+                    else
+                        lockAndSpawn(b);
+                }
+            }
+        }
+
+        int size() const { return count; }
+        RowMask getRow(int b, int y) const { return rows[y * count + b]; }
+        const RowMask *getRows() const { return rows.data(); }
+        int getScore(int b) const { return score[b]; }
+        int getHighScore(int b) const { return highScore[b]; }
+        int getLinesClearedTotal(int b) const { return lines[b]; }
+        int getPiecesPlaced(int b) const { return pieces[b]; }
+        bool isGameOver(int b) const { return gameOver[b] != 0; }
+    };
+}
+
+// ============================================================================
+// FEATURE MODULE (Board Features, SIMD Kernels)
+// ============================================================================
+
+namespace Features {
+    using namespace Config;
+    using namespace Board;
+
+    // Evaluator inputs, all derived from row bitmasks. "Covered" means some
+    // cell above in the same column is filled. Walls and floor count as
+    // filled.
+    struct BoardFeatures {
+        int heights[BOARD_W];
+        int maxHeight;
+        int aggregateHeight;
+        int bumpiness;                  // Sum of |height difference| of neighbouring columns
+        int holes;                      // Empty covered cells
+        int rowTransitions;             // Filled/empty changes along rows, walls included,
+                                        // over rows at or below the highest filled cell
+        int columnTransitions;          // Filled/empty changes down columns, floor included
+        int wells;                      // Empty uncovered cells with both sides filled
+
+        bool operator==(const BoardFeatures &o) const {
+            return memcmp(this, &o, sizeof(*this)) == 0;
+        }
+    };
+
+    // Features of many boards stored like BoardBatch: heights[x * count + b]
+    struct FeatureBatch {
+        int count;
+        vector<uint16_t> heights;
+        vector<uint16_t> maxHeight, aggregateHeight, bumpiness, holes;
+        vector<uint16_t> rowTransitions, columnTransitions, wells;
+
+        explicit FeatureBatch(int n)
+            : count(n), heights(n * BOARD_W), maxHeight(n), aggregateHeight(n), bumpiness(n),
+              holes(n), rowTransitions(n), columnTransitions(n), wells(n) {}
+
+        BoardFeatures get(int b) const {
+            BoardFeatures f;
+            for (int x = 0; x < BOARD_W; x++)
+                f.heights[x] = heights[x * count + b];
+            f.maxHeight = maxHeight[b];
+            f.aggregateHeight = aggregateHeight[b];
+            f.bumpiness = bumpiness[b];
+            f.holes = holes[b];
+            f.rowTransitions = rowTransitions[b];
+            f.columnTransitions = columnTransitions[b];
+            f.wells = wells[b];
+            return f;
+        }
+
+        void set(int b, const BoardFeatures &f) {
+            for (int x = 0; x < BOARD_W; x++)
+                heights[x * count + b] = (uint16_t)f.heights[x];
+            maxHeight[b] = (uint16_t)f.maxHeight;
+            aggregateHeight[b] = (uint16_t)f.aggregateHeight;
+            bumpiness[b] = (uint16_t)f.bumpiness;
+            holes[b] = (uint16_t)f.holes;
+            rowTransitions[b] = (uint16_t)f.rowTransitions;
+            columnTransitions[b] = (uint16_t)f.columnTransitions;
+            wells[b] = (uint16_t)f.wells;
+        }
+    };
+
+    // The kernels treat one row as one 16-bit lane with room for a wall bit
+    static_assert(sizeof(RowMask) == 2 && BOARD_W < 16, "feature kernels need 16-bit rows");
+
+    const RowMask LEFT_WALL = 1;
+    const RowMask RIGHT_WALL = (RowMask)(1u << (BOARD_W - 1));
+    const uint16_t ROW_EXT_MASK = (uint16_t)((1u << (BOARD_W + 1)) - 1);
+
+    // Reference: plain per-cell loops, no bit tricks. Only used to check the
+    // kernels, so clarity wins over speed here.
+    inline BoardFeatures extractReference(const RowMask *rows) {
+        auto filled = [&](int x, int y) {
+            if (x < 0 || x >= BOARD_W || y >= BOARD_H) return true;
+            return y >= 0 && ((rows[y] >> x) & 1) != 0;
+        };
+
+        BoardFeatures f = {};
+        int top[BOARD_W];
+        for (int x = 0; x < BOARD_W; x++) {
+            top[x] = BOARD_H;
+            for (int y = 0; y < BOARD_H; y++) {
+                if (filled(x, y)) {
+                    top[x] = y;
+                    break;
+                }
+            }
+            f.heights[x] = BOARD_H - top[x];
+            f.aggregateHeight += f.heights[x];
+            f.maxHeight = max(f.maxHeight, f.heights[x]);
+            for (int y = top[x] + 1; y < BOARD_H; y++)
+                f.holes += !filled(x, y);
+            for (int y = 0; y <= BOARD_H; y++)
+                f.columnTransitions += filled(x, y - 1) != filled(x, y);
+            for (int y = 0; y < top[x]; y++)
+                f.wells += filled(x - 1, y) && filled(x + 1, y);
+        }
+        for (int x = 0; x + 1 < BOARD_W; x++)
+            f.bumpiness += abs(f.heights[x] - f.heights[x + 1]);
+        for (int y = BOARD_H - f.maxHeight; y < BOARD_H; y++) {
+            for (int x = 0; x <= BOARD_W; x++)
+                f.rowTransitions += filled(x - 1, y) != filled(x, y);
+        }
+        return f;
+    }
+
+    // Scalar kernel: the same features row by row from the bitmasks, with
+    // cover = OR of every row so far. Also the fallback on non-x86 builds.
+    inline BoardFeatures extractScalar(const RowMask *rows) {
+        BoardFeatures f = {};
+        uint32_t cover = 0, prev = 0;
+        for (int y = 0; y < BOARD_H; y++) {
+            uint32_t row = rows[y];
+            uint32_t above = cover;
+            cover |= row;
+            f.holes += __builtin_popcount(above & ~row);
+            f.aggregateHeight += __builtin_popcount(cover);
+            // Columns whose top is this row
+            for (uint32_t fresh = cover & ~above; fresh; fresh &= fresh - 1)
+                f.heights[__builtin_ctz(fresh)] = BOARD_H - y;
+            if (cover && !above)
+                f.maxHeight = BOARD_H - y;
+            f.bumpiness += __builtin_popcount((cover ^ (cover >> 1)) & (FULL_ROW >> 1));
+            f.wells += __builtin_popcount(~cover & FULL_ROW & ((row << 1) | LEFT_WALL) & ((row >> 1) | RIGHT_WALL));
+            uint32_t ext = row | (1u << BOARD_W);
+            if (cover)
+                f.rowTransitions += __builtin_popcount((ext ^ ((ext << 1) | 1)) & ROW_EXT_MASK);
+            f.columnTransitions += __builtin_popcount(prev ^ row);
+            prev = row;
+        }
+        f.columnTransitions += __builtin_popcount(prev ^ FULL_ROW);
+        return f;
+    }
+
+    inline void extractBatchScalar(const RowMask *rows, int count, int begin, FeatureBatch &out) {
+        RowMask board[BOARD_H];
+        for (int b = begin; b < count; b++) {
+            for (int y = 0; y < BOARD_H; y++)
+                board[y] = rows[y * count + b];
+            out.set(b, extractScalar(board));
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // Single board: rows become lanes, padded with empty rows on top so the
+    // board fills whole vectors. The cover prefix is serial, so it is built
+    // with scalar ORs (which also yield the column heights); everything else
+    // is lane-parallel, and each feature is a population count summed over
+    // all lanes.
+    const int SIMD_ROWS = (BOARD_H + 15) & ~15;
+
+    // Heights and maxHeight from the row where each column's top appears
+    inline void columnHeights(const RowMask *rows, BoardFeatures &f) {
+        uint32_t cover = 0;
+        f.maxHeight = 0;
+        for (int x = 0; x < BOARD_W; x++)
+            f.heights[x] = 0;
+        for (int y = 0; y < BOARD_H && cover != FULL_ROW; y++) {
+            uint32_t fresh = rows[y] & ~cover;
+            cover |= rows[y];
+            if (fresh && !f.maxHeight)
+                f.maxHeight = BOARD_H - y;
+            for (; fresh; fresh &= fresh - 1)
+                f.heights[__builtin_ctz(fresh)] = BOARD_H - y;
+        }
+    }
+    const int SIMD_PAD = SIMD_ROWS - BOARD_H;
+
+    struct alignas(32) LaneRows {
+        uint16_t row[SIMD_ROWS + 1];    // row[i + 1] is lane i, row[0] the empty row above
+        uint16_t cover[SIMD_ROWS + 1];
+
+        explicit LaneRows(const RowMask *rows) {
+            memset(row, 0, sizeof(row));
+            memset(cover, 0, sizeof(cover));
+            uint16_t c = 0;
+            for (int y = 0; y < BOARD_H; y++) {
+                c |= rows[y];
+                row[SIMD_PAD + 1 + y] = rows[y];
+                cover[SIMD_PAD + 1 + y] = c;
+            }
+        }
+    };
+
+    __attribute__((target("sse2")))
+    inline __m128i popcountBytesSSE2(__m128i v) {
+        const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0F);
+        v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1));
+        v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+        return _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4);
+    }
+
+    // Per 16-bit lane
+    __attribute__((target("sse2")))
+    inline __m128i popcount16SSE2(__m128i v) {
+        v = popcountBytesSSE2(v);
+        return _mm_and_si128(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), _mm_set1_epi16(0x1F));
+    }
+
+    // Sum over all lanes, accumulated as two 64-bit halves
+    __attribute__((target("sse2")))
+    inline __m128i popcountSumSSE2(__m128i acc, __m128i v) {
+        return _mm_add_epi64(acc, _mm_sad_epu8(popcountBytesSSE2(v), _mm_setzero_si128()));
+    }
+
+    __attribute__((target("sse2")))
+    inline int horizontalSumSSE2(__m128i acc) {
+        return _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc));
+    }
+
+    __attribute__((target("sse2")))
+    BoardFeatures extractSSE2(const RowMask *rows) {
+        LaneRows lanes(rows);
+        const __m128i full = _mm_set1_epi16((short)FULL_ROW);
+        const __m128i half = _mm_set1_epi16((short)(FULL_ROW >> 1));
+        const __m128i leftWall = _mm_set1_epi16((short)LEFT_WALL);
+        const __m128i rightWall = _mm_set1_epi16((short)RIGHT_WALL);
+        const __m128i extWall = _mm_set1_epi16((short)(1u << BOARD_W));
+        const __m128i extMask = _mm_set1_epi16((short)ROW_EXT_MASK);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i holes = zero, aggregate = zero, bump = zero, wells = zero, rowT = zero, colT = zero;
+        for (int i = 0; i < SIMD_ROWS; i += 8) {
+            __m128i row = _mm_loadu_si128((const __m128i *)&lanes.row[i + 1]);
+            __m128i prev = _mm_loadu_si128((const __m128i *)&lanes.row[i]);
+            __m128i cover = _mm_loadu_si128((const __m128i *)&lanes.cover[i + 1]);
+            __m128i above = _mm_loadu_si128((const __m128i *)&lanes.cover[i]);
+
+            holes = popcountSumSSE2(holes, _mm_andnot_si128(row, above));
+            aggregate = popcountSumSSE2(aggregate, cover);
+            bump = popcountSumSSE2(bump, _mm_and_si128(_mm_xor_si128(cover, _mm_srli_epi16(cover, 1)), half));
+            __m128i sides = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(row, 1), leftWall),
+                                          _mm_or_si128(_mm_srli_epi16(row, 1), rightWall));
+            wells = popcountSumSSE2(wells, _mm_andnot_si128(cover, _mm_and_si128(sides, full)));
+            __m128i ext = _mm_or_si128(row, extWall);
+            __m128i trans = _mm_and_si128(_mm_xor_si128(ext, _mm_or_si128(_mm_slli_epi16(ext, 1), leftWall)), extMask);
+            __m128i empty = _mm_cmpeq_epi16(cover, zero);
+            rowT = popcountSumSSE2(rowT, _mm_andnot_si128(empty, trans));
+            colT = popcountSumSSE2(colT, _mm_xor_si128(prev, row));
+        }
+
+        BoardFeatures f;
+        columnHeights(rows, f);
+        f.aggregateHeight = horizontalSumSSE2(aggregate);
+        f.bumpiness = horizontalSumSSE2(bump);
+        f.holes = horizontalSumSSE2(holes);
+        f.rowTransitions = horizontalSumSSE2(rowT);
+        f.columnTransitions = horizontalSumSSE2(colT) + __builtin_popcount(rows[BOARD_H - 1] ^ FULL_ROW);
+        f.wells = horizontalSumSSE2(wells);
+        return f;
+    }
+
+    // Many boards: boards become lanes (8 per vector) and the loop walks
+    // down the rows, so the cover prefix is just a running OR per lane.
+    __attribute__((target("sse2")))
+    void extractBatchSSE2(const RowMask *rows, int count, FeatureBatch &out) {
+        const __m128i full = _mm_set1_epi16((short)FULL_ROW);
+        const __m128i half = _mm_set1_epi16((short)(FULL_ROW >> 1));
+        const __m128i leftWall = _mm_set1_epi16((short)LEFT_WALL);
+        const __m128i rightWall = _mm_set1_epi16((short)RIGHT_WALL);
+        const __m128i extWall = _mm_set1_epi16((short)(1u << BOARD_W));
+        const __m128i extMask = _mm_set1_epi16((short)ROW_EXT_MASK);
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i zero = _mm_setzero_si128();
+
+        int b = 0;
+        for (; b + 8 <= count; b += 8) {
+            __m128i cover = zero, prev = zero;
+            __m128i holes = zero, aggregate = zero, maxH = zero, bump = zero;
+            __m128i wells = zero, rowT = zero, colT = zero;
+            __m128i heights[BOARD_W];
+            for (int x = 0; x < BOARD_W; x++)
+                heights[x] = zero;
+
+            for (int y = 0; y < BOARD_H; y++) {
+                __m128i row = _mm_loadu_si128((const __m128i *)&rows[y * count + b]);
+                __m128i above = cover;
+                cover = _mm_or_si128(cover, row);
+
+                holes = _mm_add_epi16(holes, popcount16SSE2(_mm_andnot_si128(row, above)));
+                aggregate = _mm_add_epi16(aggregate, popcount16SSE2(cover));
+                __m128i empty = _mm_cmpeq_epi16(cover, zero);
+                maxH = _mm_add_epi16(maxH, _mm_andnot_si128(empty, one));
+                bump = _mm_add_epi16(bump, popcount16SSE2(
+                    _mm_and_si128(_mm_xor_si128(cover, _mm_srli_epi16(cover, 1)), half)));
+                __m128i sides = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(row, 1), leftWall),
+                                              _mm_or_si128(_mm_srli_epi16(row, 1), rightWall));
+                wells = _mm_add_epi16(wells, popcount16SSE2(_mm_andnot_si128(cover, _mm_and_si128(sides, full))));
+                __m128i ext = _mm_or_si128(row, extWall);
+                __m128i trans = _mm_and_si128(_mm_xor_si128(ext, _mm_or_si128(_mm_slli_epi16(ext, 1), leftWall)), extMask);
+                rowT = _mm_add_epi16(rowT, popcount16SSE2(_mm_andnot_si128(empty, trans)));
+                colT = _mm_add_epi16(colT, popcount16SSE2(_mm_xor_si128(prev, row)));
+                for (int x = 0; x < BOARD_W; x++)
+                    heights[x] = _mm_add_epi16(heights[x], _mm_and_si128(_mm_srli_epi16(cover, x), one));
+                prev = row;
+            }
+            colT = _mm_add_epi16(colT, popcount16SSE2(_mm_xor_si128(prev, full)));
+
+            for (int x = 0; x < BOARD_W; x++)
+                _mm_storeu_si128((__m128i *)&out.heights[x * count + b], heights[x]);
+            _mm_storeu_si128((__m128i *)&out.maxHeight[b], maxH);
+            _mm_storeu_si128((__m128i *)&out.aggregateHeight[b], aggregate);
+            _mm_storeu_si128((__m128i *)&out.bumpiness[b], bump);
+            _mm_storeu_si128((__m128i *)&out.holes[b], holes);
+            _mm_storeu_si128((__m128i *)&out.rowTransitions[b], rowT);
+            _mm_storeu_si128((__m128i *)&out.columnTransitions[b], colT);
+            _mm_storeu_si128((__m128i *)&out.wells[b], wells);
+        }
+        extractBatchScalar(rows, count, b, out);
+    }
+
+    // AVX2 versions (every AVX2 CPU also has POPCNT): 16 lanes per vector
+    // and a nibble-table popcount
+    __attribute__((target("avx2,popcnt")))
+    inline __m256i popcountBytesAVX2(__m256i v) {
+        const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                               0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low = _mm256_set1_epi8(0x0F);
+        return _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(v, low)),
+                               _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    inline __m256i popcount16AVX2(__m256i v) {
+        v = popcountBytesAVX2(v);
+        return _mm256_add_epi16(_mm256_and_si256(v, _mm256_set1_epi16(0xFF)), _mm256_srli_epi16(v, 8));
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    inline __m256i popcountSumAVX2(__m256i acc, __m256i v) {
+        return _mm256_add_epi64(acc, _mm256_sad_epu8(popcountBytesAVX2(v), _mm256_setzero_si256()));
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    inline int horizontalSumAVX2(__m256i acc) {
+        __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum));
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    BoardFeatures extractAVX2(const RowMask *rows) {
+        LaneRows lanes(rows);
+        const __m256i full = _mm256_set1_epi16((short)FULL_ROW);
+        const __m256i half = _mm256_set1_epi16((short)(FULL_ROW >> 1));
+        const __m256i leftWall = _mm256_set1_epi16((short)LEFT_WALL);
+        const __m256i rightWall = _mm256_set1_epi16((short)RIGHT_WALL);
+        const __m256i extWall = _mm256_set1_epi16((short)(1u << BOARD_W));
+        const __m256i extMask = _mm256_set1_epi16((short)ROW_EXT_MASK);
+        const __m256i zero = _mm256_setzero_si256();
+
+        __m256i holes = zero, aggregate = zero, bump = zero, wells = zero, rowT = zero, colT = zero;
+        int emptyLanes = 0;
+        int heights[BOARD_W] = {};
+        for (int i = 0; i < SIMD_ROWS; i += 16) {
+            __m256i row = _mm256_loadu_si256((const __m256i *)&lanes.row[i + 1]);
+            __m256i prev = _mm256_loadu_si256((const __m256i *)&lanes.row[i]);
+            __m256i cover = _mm256_loadu_si256((const __m256i *)&lanes.cover[i + 1]);
+            __m256i above = _mm256_loadu_si256((const __m256i *)&lanes.cover[i]);
+
+            holes = popcountSumAVX2(holes, _mm256_andnot_si256(row, above));
+            aggregate = popcountSumAVX2(aggregate, cover);
+            bump = popcountSumAVX2(bump, _mm256_and_si256(_mm256_xor_si256(cover, _mm256_srli_epi16(cover, 1)), half));
+            __m256i sides = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(row, 1), leftWall),
+                                             _mm256_or_si256(_mm256_srli_epi16(row, 1), rightWall));
+            wells = popcountSumAVX2(wells, _mm256_andnot_si256(cover, _mm256_and_si256(sides, full)));
+            __m256i ext = _mm256_or_si256(row, extWall);
+            __m256i trans = _mm256_and_si256(_mm256_xor_si256(ext, _mm256_or_si256(_mm256_slli_epi16(ext, 1), leftWall)), extMask);
+            __m256i empty = _mm256_cmpeq_epi16(cover, zero);
+            rowT = popcountSumAVX2(rowT, _mm256_andnot_si256(empty, trans));
+            colT = popcountSumAVX2(colT, _mm256_xor_si256(prev, row));
+            emptyLanes += _mm_popcnt_u32(_mm256_movemask_epi8(empty)) / 2;
+            for (int x = 0; x < BOARD_W; x++) {
+                __m256i bit = _mm256_set1_epi16((short)(1u << x));
+                __m256i set = _mm256_cmpeq_epi16(_mm256_and_si256(cover, bit), bit);
+                heights[x] += _mm_popcnt_u32(_mm256_movemask_epi8(set)) / 2;
+            }
+        }
+
+        BoardFeatures f;
+        memcpy(f.heights, heights, sizeof(heights));
+        f.maxHeight = SIMD_ROWS - emptyLanes;
+        f.aggregateHeight = horizontalSumAVX2(aggregate);
+        f.bumpiness = horizontalSumAVX2(bump);
+        f.holes = horizontalSumAVX2(holes);
+        f.rowTransitions = horizontalSumAVX2(rowT);
+        f.columnTransitions = horizontalSumAVX2(colT) + __builtin_popcount(rows[BOARD_H - 1] ^ FULL_ROW);
+        f.wells = horizontalSumAVX2(wells);
+        return f;
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    void extractBatchAVX2(const RowMask *rows, int count, FeatureBatch &out) {
+        const __m256i full = _mm256_set1_epi16((short)FULL_ROW);
+        const __m256i half = _mm256_set1_epi16((short)(FULL_ROW >> 1));
+        const __m256i leftWall = _mm256_set1_epi16((short)LEFT_WALL);
+        const __m256i rightWall = _mm256_set1_epi16((short)RIGHT_WALL);
+        const __m256i extWall = _mm256_set1_epi16((short)(1u << BOARD_W));
+        const __m256i extMask = _mm256_set1_epi16((short)ROW_EXT_MASK);
+        const __m256i one = _mm256_set1_epi16(1);
+        const __m256i zero = _mm256_setzero_si256();
+
+        int b = 0;
+        for (; b + 16 <= count; b += 16) {
+            __m256i cover = zero, prev = zero;
+            __m256i holes = zero, aggregate = zero, maxH = zero, bump = zero;
+            __m256i wells = zero, rowT = zero, colT = zero;
+            __m256i heights[BOARD_W];
+            for (int x = 0; x < BOARD_W; x++)
+                heights[x] = zero;
+
+            for (int y = 0; y < BOARD_H; y++) {
+                __m256i row = _mm256_loadu_si256((const __m256i *)&rows[y * count + b]);
+                __m256i above = cover;
+                cover = _mm256_or_si256(cover, row);
+
+                holes = _mm256_add_epi16(holes, popcount16AVX2(_mm256_andnot_si256(row, above)));
+                aggregate = _mm256_add_epi16(aggregate, popcount16AVX2(cover));
+                __m256i empty = _mm256_cmpeq_epi16(cover, zero);
+                maxH = _mm256_add_epi16(maxH, _mm256_andnot_si256(empty, one));
+                bump = _mm256_add_epi16(bump, popcount16AVX2(
+                    _mm256_and_si256(_mm256_xor_si256(cover, _mm256_srli_epi16(cover, 1)), half)));
+                __m256i sides = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(row, 1), leftWall),
+                                                 _mm256_or_si256(_mm256_srli_epi16(row, 1), rightWall));
+                wells = _mm256_add_epi16(wells, popcount16AVX2(_mm256_andnot_si256(cover, _mm256_and_si256(sides, full))));
+                __m256i ext = _mm256_or_si256(row, extWall);
+                __m256i trans = _mm256_and_si256(_mm256_xor_si256(ext, _mm256_or_si256(_mm256_slli_epi16(ext, 1), leftWall)), extMask);
+                rowT = _mm256_add_epi16(rowT, popcount16AVX2(_mm256_andnot_si256(empty, trans)));
+                colT = _mm256_add_epi16(colT, popcount16AVX2(_mm256_xor_si256(prev, row)));
+                for (int x = 0; x < BOARD_W; x++)
+                    heights[x] = _mm256_add_epi16(heights[x], _mm256_and_si256(_mm256_srli_epi16(cover, x), one));
+                prev = row;
+            }
+            colT = _mm256_add_epi16(colT, popcount16AVX2(_mm256_xor_si256(prev, full)));
+
+            for (int x = 0; x < BOARD_W; x++)
+                _mm256_storeu_si256((__m256i *)&out.heights[x * count + b], heights[x]);
+            _mm256_storeu_si256((__m256i *)&out.maxHeight[b], maxH);
+            _mm256_storeu_si256((__m256i *)&out.aggregateHeight[b], aggregate);
+            _mm256_storeu_si256((__m256i *)&out.bumpiness[b], bump);
+            _mm256_storeu_si256((__m256i *)&out.holes[b], holes);
+            _mm256_storeu_si256((__m256i *)&out.rowTransitions[b], rowT);
+            _mm256_storeu_si256((__m256i *)&out.columnTransitions[b], colT);
+            _mm256_storeu_si256((__m256i *)&out.wells[b], wells);
+        }
+        extractBatchScalar(rows, count, b, out);
+    }
+#endif
+
+    enum Kernel {
+        KERNEL_SCALAR = 0,
+        KERNEL_SSE2,
+        KERNEL_AVX2,
+        KERNEL_COUNT
+    };
+
+    inline const char *kernelName(Kernel k) {
+        return k == KERNEL_AVX2 ? "avx2" : k == KERNEL_SSE2 ? "sse2" : "scalar";
+    }
+
+    inline bool kernelSupported(Kernel k) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (k == KERNEL_AVX2) return __builtin_cpu_supports("avx2");
+        if (k == KERNEL_SSE2) return __builtin_cpu_supports("sse2");
+#endif
+        return k == KERNEL_SCALAR;
+    }
+
+    // Widest kernel this CPU runs, picked once
+    inline Kernel bestKernel() {
+        static const Kernel best = kernelSupported(KERNEL_AVX2) ? KERNEL_AVX2
+                                 : kernelSupported(KERNEL_SSE2) ? KERNEL_SSE2 : KERNEL_SCALAR;
+        return best;
+    }
+
+    inline BoardFeatures extract(const RowMask *rows, Kernel k = bestKernel()) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (k == KERNEL_AVX2) return extractAVX2(rows);
+        if (k == KERNEL_SSE2) return extractSSE2(rows);
+#endif
+        return extractScalar(rows);
+    }
+
+    // rows in BoardBatch layout: rows[y * count + b]
+    inline void extractBatch(const RowMask *rows, int count, FeatureBatch &out, Kernel k = bestKernel()) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (k == KERNEL_AVX2) return extractBatchAVX2(rows, count, out);
+        if (k == KERNEL_SSE2) return extractBatchSSE2(rows, count, out);
+#endif
+        extractBatchScalar(rows, count, 0, out);
+    }
+}
+
+// ============================================================================
+// PARALLEL MODULE (Work-Stealing Thread Pool)
+// ============================================================================
+
+namespace Parallel {
+    // Persistent workers that split each parallelFor into one contiguous
+    // range per worker. A worker takes chunks from the front of its own
+    // range; once that is empty it steals the back half of another
+    // worker's range. Each range is a single atomic word (begin | end << 32)
+    // so owner pops and thief splits never need a lock.
+    class WorkStealingPool {
+    private:
+        struct alignas(64) WorkRange {
+            atomic<uint64_t> bounds;
+        };
+
+        typedef function<void(int worker, long begin, long end)> Job;
+
+        vector<thread> workers;
+        unique_ptr<WorkRange[]> ranges;
+        int threadCount;
+        long grain;
+        Job job;
+
+        mutex wakeMutex;
+        condition_variable wakeCond;
+        condition_variable doneCond;
+        uint64_t generation;
+        int running;
+        bool stopping;
+
+        static uint64_t pack(uint32_t begin, uint32_t end) {
+            return (uint64_t)begin | ((uint64_t)end << 32);
+        }
+
+        bool popLocal(int w, long &begin, long &end) {
+            atomic<uint64_t> &bounds = ranges[w].bounds;
+            uint64_t cur = bounds.load(memory_order_relaxed);
+            while (true) {
+                uint32_t b = (uint32_t)cur, e = (uint32_t)(cur >> 32);
+                if (b >= e) return false;
+                uint32_t nb = (e - b > (uint32_t)grain) ? b + (uint32_t)grain : e;
+                if (bounds.compare_exchange_weak(cur, pack(nb, e), memory_order_acq_rel)) {
+                    begin = b;
+                    end = nb;
+                    return true;
+                }
+            }
+        }
+
+        bool steal(int thief) {
+            for (int i = 1; i < threadCount; i++) {
+                atomic<uint64_t> &bounds = ranges[(thief + i) % threadCount].bounds;
+                uint64_t cur = bounds.load(memory_order_relaxed);
+                while (true) {
+                    uint32_t b = (uint32_t)cur, e = (uint32_t)(cur >> 32);
+                    if (b >= e) break;
+                    uint32_t mid = b + (e - b) / 2;
+                    if (bounds.compare_exchange_weak(cur, pack(b, mid), memory_order_acq_rel)) {
+                        ranges[thief].bounds.store(pack(mid, e), memory_order_release);
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        void runWorker(int w) {
+            long begin, end;
+            do {
+                while (popLocal(w, begin, end))
+                    job(w, begin, end);
+            } while (steal(w));
+        }
+
+        void workerLoop(int w) {
+            uint64_t seen = 0;
+            while (true) {
+                {
+                    unique_lock<mutex> lock(wakeMutex);
+                    wakeCond.wait(lock, [&] { return stopping || generation != seen; });
+                    if (stopping) return;
+                    seen = generation;
+                }
+                runWorker(w);
+                {
+                    lock_guard<mutex> lock(wakeMutex);
+                    if (--running == 0)
+                        doneCond.notify_one();
+                }
+            }
+        }
+
+    public:
+        explicit WorkStealingPool(int threads = 0)
+            : threadCount(threads > 0 ? threads : max(1u, thread::hardware_concurrency())),
+              grain(1), generation(0), running(0), stopping(false) {
+            ranges.reset(new WorkRange[threadCount]);
+            for (int w = 0; w < threadCount; w++)
+                ranges[w].bounds.store(0);
+            for (int w = 0; w < threadCount; w++)
+                workers.emplace_back(&WorkStealingPool::workerLoop, this, w);
+        }
+
+        ~WorkStealingPool() {
+            {
+                lock_guard<mutex> lock(wakeMutex);
+                stopping = true;
+            }
+            wakeCond.notify_all();
+            for (auto &t : workers)
+                t.join();
+        }
+
+        // Calls fn(worker, begin, end) over [0, count) in chunks of at most
+        // chunkSize items and blocks until every item has been processed.
+        void parallelFor(long count, long chunkSize, Job fn) {
+            if (count <= 0) return;
+            job = std::move(fn);
+            grain = chunkSize > 0 ? chunkSize : 1;
+            for (int w = 0; w < threadCount; w++) {
+                uint32_t b = (uint32_t)(count * w / threadCount);
+                uint32_t e = (uint32_t)(count * (w + 1) / threadCount);
+                ranges[w].bounds.store(pack(b, e), memory_order_relaxed);
+            }
+
+            unique_lock<mutex> lock(wakeMutex);
+            running = threadCount;
+            generation++;
+            wakeCond.notify_all();
+            doneCond.wait(lock, [&] { return running == 0; });
+        }
+
+        int size() const { return threadCount; }
+    };
+}
+
+// ============================================================================
+// SELF-PLAY MODULE
+// ============================================================================
+
+namespace SelfPlay {
+    using namespace Config;
+    using namespace GameEngine;
+
+    struct Totals {
+        long games = 0;
+        long pieces = 0;
+        long lines = 0;
+        long long score = 0;
+
+        void add(const Totals &other) {
+            games += other.games;
+            pieces += other.pieces;
+            lines += other.lines;
+            score += other.score;
+        }
+    };
+
+    // Everything one worker touches while playing. It is created by the
+    // worker thread itself and reused for every game that thread plays, so
+    // steady-state self-play never allocates and never shares a cache line.
+    struct alignas(64) WorkerState {
+        Game game;
+        Random::Xoshiro128 policyRng;
+        Totals totals;
+
+        explicit WorkerState(uint64_t seed) : game(seed), policyRng(seed ^ 0xA5A5A5A5u) {}
+    };
+
+    // Baseline policy: random rotation and column, then hard drop
+    void playRandomPlacement(Game &game, Random::Xoshiro128 &rng) {
+        int rotations = (int)rng.nextBelow(ROTATIONS);
+        for (int r = 0; r < rotations; r++)
+            game.tryRotate();
+
+        int targetX = (int)rng.nextBelow(BOARD_W);
+        while (game.getCurrentPiece().x < targetX && game.tryMove(1, 0)) {}
+        while (game.getCurrentPiece().x > targetX && game.tryMove(-1, 0)) {}
+        game.hardDrop();
+    }
+
+    class SelfPlayRunner {
+    private:
+        Parallel::WorkStealingPool pool;
+        vector<unique_ptr<WorkerState>> workers;
+
+    public:
+        explicit SelfPlayRunner(int threads = 0) : pool(threads), workers(pool.size()) {}
+
+        // Plays games [0, games) with game i seeded from seed + i. Each
+        // worker accumulates into its own slot; slots are summed afterwards.
+        Totals run(long games, long maxPieces, uint64_t seed) {
+            for (auto &w : workers) {
+                if (w) w->totals = Totals();
+            }
+
+            pool.parallelFor(games, 16, [&](int w, long begin, long end) {
+                if (!workers[w])
+                    workers[w].reset(new WorkerState(seed));
+                WorkerState &state = *workers[w];
+                for (long i = begin; i < end; i++) {
+                    state.game.reset(seed + (uint64_t)i);
+                    state.policyRng.reseed(~(seed + (uint64_t)i));
+                    while (!state.game.isGameOver() && state.game.getPiecesPlaced() < maxPieces)
+                        playRandomPlacement(state.game, state.policyRng);
+
+                    state.totals.games++;
+                    state.totals.pieces += state.game.getPiecesPlaced();
+                    state.totals.lines += state.game.getBoard().getLinesClearedTotal();
+                    state.totals.score += state.game.getBoard().getScore();
+                }
+            });
+
+            Totals sum;
+            for (auto &w : workers) {
+                if (w) sum.add(w->totals);
+            }
+            return sum;
+        }
+
+        int threadCount() const { return pool.size(); }
+    };
+}
+
+// ============================================================================
+// BOT MODULE (Beam Search Autoplay)
+// ============================================================================
+
+namespace Bot {
+    using namespace Config;
+    using namespace Tetromino;
+    using namespace Board;
+    using namespace GameEngine;
+
+    typedef chrono::steady_clock Clock;
+
+    // Linear board evaluation; larger is better. The last three terms need
+    // a full feature extraction, so they cost nothing while left at zero.
+    struct Weights {
+        float holes = -0.35663f;
+        float bumpiness = -0.184483f;
+        float aggregateHeight = -0.510066f;
+        float lines = 0.760666f;
+        float rowTransitions = 0;
+        float columnTransitions = 0;
+        float wells = 0;
+
+        bool usesFeatureKernel() const {
+            return rowTransitions != 0 || columnTransitions != 0 || wells != 0;
+        }
+    };
+
+    struct BotConfig {
+        Weights weights;
+        int beamWidth = 8;              // Placements of the current piece expanded with the preview
+        int64_t budgetUs = 5000;        // Per-move search budget
+        int threads = 1;                // Scoring threads, 1 = search inline
+        int tableBits = 16;             // log2 of transposition table slots, 0 = no table
+    };
+
+    const float DEAD_SCORE = -1e9f;
+
+    inline float evaluate(const GameBoard &board, int lines, const Weights &w) {
+        float score = w.holes * board.getTotalHoles() +
+                      w.bumpiness * board.getBumpiness() +
+                      w.aggregateHeight * board.getAggregateHeight() +
+                      w.lines * lines;
+        if (w.usesFeatureKernel()) {
+            Features::BoardFeatures f = Features::extract(board.getRows());
+            score += w.rowTransitions * f.rowTransitions +
+                     w.columnTransitions * f.columnTransitions +
+                     w.wells * f.wells;
+        }
+        return score;
+    }
+
+    inline Piece atPlacement(Piece piece, const Search::Placement &p) {
+        piece.x = p.x;
+        piece.y = p.y;
+        piece.rotation = p.rotation;
+        return piece;
+    }
+
+    // Places piece at p on board and clears lines. Returns the lines
+    // cleared, or -1 if part of the piece locked above the board.
+    inline int applyPlacement(GameBoard &board, Piece piece, const Search::Placement &p) {
+        piece = atPlacement(piece, p);
+        if (piece.y + piece.state().minY < 0) return -1;
+        board.lockPiece(piece);
+        return board.clearLines();
+    }
+
+    // Two-ply beam search over the current piece and the preview. Every
+    // placement of the current piece is scored on its own; the best
+    // beamWidth of them are expanded with every placement of the next piece,
+    // in parallel, and ranked by their best child. If the time budget runs
+    // out, only the nodes that were expanded compete (the one-ply best when
+    // none were). Board evaluations go through a transposition table keyed
+    // by Zobrist hash, which the threads (and other planners) can share.
+    // All buffers are allocated up front, so planning a move never touches
+    // the heap.
+    class Planner {
+    public:
+        static const int MAX_BEAM = 64;
+        static const int MAX_PATH = Search::PlacementEnumerator::STATE_COUNT + 1;
+
+    private:
+        struct Candidate {
+            int placement;
+            int lines;
+            float score;
+        };
+
+        struct alignas(64) Worker {
+            Search::PlacementEnumerator search;
+            GameBoard scratch;
+            Search::TranspositionTable::Stats stats;
+        };
+
+        BotConfig config;
+        unique_ptr<Search::TranspositionTable> ownTable;
+        Search::TranspositionTable *table;
+        uint64_t weightsKey;            // Keeps entries of differently weighted planners apart
+        unique_ptr<Parallel::WorkStealingPool> pool;
+        vector<unique_ptr<Worker>> workers;
+        Search::PlacementEnumerator rootSearch;
+        Candidate candidates[Search::PlacementEnumerator::STATE_COUNT];
+        GameBoard beamBoards[MAX_BEAM];
+        float beamScores[MAX_BEAM];
+        bool beamExpanded[MAX_BEAM];
+        atomic<int> expanded;
+
+        // Inputs set up by plan() for the parallel expansion
+        Piece previewPiece;
+        int beamSize;
+        Clock::time_point deadline;
+
+        // Heuristic of board after placing piece at p, without the lines
+        // term; lines gets the rows it clears. A placement that clears
+        // nothing is looked up by its would-be hash before the board is
+        // even copied.
+        float placementValue(Worker &w, const GameBoard &board, const Piece &piece,
+                             const Search::Placement &p, int &lines) {
+            Piece placed = atPlacement(piece, p);
+            lines = 0;
+            if (placed.y + placed.state().minY < 0) return DEAD_SCORE;
+
+            uint64_t key;
+            float value;
+            bool known = board.hashAfterLock(placed, key);
+            if (known && table && table->probe(key ^ weightsKey, value, w.stats))
+                return value;
+
+            w.scratch = board;
+            w.scratch.lockPiece(placed);
+            lines = w.scratch.clearLines();
+            key = w.scratch.getHash() ^ weightsKey;
+            if (!known && table && table->probe(key, value, w.stats))
+                return value;
+            value = evaluate(w.scratch, 0, config.weights);
+            if (table)
+                table->store(key, value, w.stats);
+            return value;
+        }
+
+        void expand(int worker, long begin, long end) {
+            Worker &w = *workers[worker];
+            for (long k = begin; k < end; k++) {
+                if (Clock::now() >= deadline) return;
+                const GameBoard &board = beamBoards[k];
+                float best = DEAD_SCORE;
+                // A dead parent, or one that blocks the spawn, has no children
+                if (candidates[k].score > DEAD_SCORE &&
+                    board.fitsAt(previewPiece.type, previewPiece.rotation, previewPiece.x, previewPiece.y)) {
+                    int n = w.search.enumerate(board, previewPiece);
+                    for (int i = 0; i < n; i++) {
+                        int lines;
+                        float value = placementValue(w, board, previewPiece, w.search.get(i), lines);
+                        if (value > DEAD_SCORE)
+                            best = max(best, value + config.weights.lines * (candidates[k].lines + lines));
+                    }
+                }
+                beamScores[k] = best;
+                beamExpanded[k] = true;
+                expanded.fetch_add(1, memory_order_relaxed);
+            }
+        }
+
+    public:
+        // Uses shared as its transposition table if given, otherwise its own
+        // of config.tableBits
+        explicit Planner(const BotConfig &cfg = BotConfig(), Search::TranspositionTable *shared = nullptr)
+            : config(cfg), table(shared), expanded(0), beamSize(0) {
+            config.beamWidth = max(1, min(config.beamWidth, (int)MAX_BEAM));
+            if (!table && config.tableBits > 0) {
+                ownTable.reset(new Search::TranspositionTable(config.tableBits));
+                table = ownTable.get();
+            }
+            setWeights(config.weights);
+            if (config.threads > 1)
+                pool.reset(new Parallel::WorkStealingPool(config.threads));
+            int count = pool ? pool->size() : 1;
+            for (int i = 0; i < count; i++)
+                workers.emplace_back(new Worker());
+        }
+
+        void setWeights(const Weights &w) {
+            config.weights = w;
+            const float weights[] = {w.holes, w.bumpiness, w.aggregateHeight, w.lines,
+                                     w.rowTransitions, w.columnTransitions, w.wells};
+            uint64_t state = 0;
+            for (float f : weights) {
+                uint32_t bits;
+                memcpy(&bits, &f, sizeof(bits));
+                state ^= bits;
+                weightsKey = Random::splitMix64(state);
+            }
+        }
+
+        // Writes the inputs for the best move of game's current piece to
+        // path (ending in a hard drop) and returns their count, 0 if the
+        // piece has no placement.
+        int plan(const Game &game, unsigned *path) {
+            const GameBoard &board = game.getBoard();
+            const Piece &piece = game.getCurrentPiece();
+            deadline = Clock::now() + chrono::microseconds(config.budgetUs);
+
+            int n = rootSearch.enumerate(board, piece);
+            if (n == 0) return 0;
+
+            for (int i = 0; i < n; i++) {
+                int lines;
+                float value = placementValue(*workers[0], board, piece, rootSearch.get(i), lines);
+                candidates[i] = Candidate{i, lines,
+                                          value > DEAD_SCORE ? value + config.weights.lines * lines : DEAD_SCORE};
+            }
+
+            beamSize = min(n, config.beamWidth);
+            partial_sort(candidates, candidates + beamSize, candidates + n,
+                         [](const Candidate &a, const Candidate &b) { return a.score > b.score; });
+            for (int k = 0; k < beamSize; k++) {
+                beamBoards[k] = board;
+                applyPlacement(beamBoards[k], piece, rootSearch.get(candidates[k].placement));
+                beamScores[k] = candidates[k].score;
+                beamExpanded[k] = false;
+            }
+
+            previewPiece = game.getNextPiece();
+            Game::moveToSpawn(previewPiece);
+            expanded.store(0, memory_order_relaxed);
+            if (pool)
+                pool->parallelFor(beamSize, 1, [this](int w, long begin, long end) { expand(w, begin, end); });
+            else
+                expand(0, 0, beamSize);
+
+            // candidates[0] is the one-ply best, the answer if nothing was expanded
+            int best = 0;
+            for (int k = 0; k < beamSize; k++) {
+                if (beamExpanded[k] && (!beamExpanded[best] || beamScores[k] > beamScores[best]))
+                    best = k;
+            }
+            return rootSearch.pathTo(rootSearch.get(candidates[best].placement), path, MAX_PATH);
+        }
+
+        // Beam nodes the last plan() expanded before its deadline
+        int getExpanded() const { return expanded.load(memory_order_relaxed); }
+        int getBeamSize() const { return beamSize; }
+        const BotConfig &getConfig() const { return config; }
+        const Search::TranspositionTable *getTable() const { return table; }
+
+        Search::TranspositionTable::Stats getTableStats() const {
+            Search::TranspositionTable::Stats sum;
+            for (auto &w : workers)
+                sum.add(w->stats);
+            return sum;
+        }
+    };
+
+    // Input source for Game: plans once per piece and then replays the
+    // path one Game::step input at a time. If gravity moves the piece
+    // between inputs, or locks it before the path is done, the rest of the
+    // path is stale and the piece gets a fresh plan from where it is.
+    class AutoPlayer {
+    private:
+        Planner planner;
+        unsigned path[Planner::MAX_PATH];
+        int pathLength;
+        int pathPos;
+        long plannedFor;                // Game::getPiecesPlaced() when the path was planned
+        int expectedY;                  // Lowest row the piece may be on if only our inputs moved it
+
+    public:
+        explicit AutoPlayer(const BotConfig &cfg = BotConfig())
+            : planner(cfg), pathLength(0), pathPos(0), plannedFor(-1), expectedY(0) {}
+
+        unsigned nextInput(const Game &game) {
+            if (game.isGameOver()) return INPUT_NONE;
+            const Piece &piece = game.getCurrentPiece();
+            if (pathPos >= pathLength || game.getPiecesPlaced() != plannedFor || piece.y > expectedY) {
+                plannedFor = game.getPiecesPlaced();
+                pathLength = planner.plan(game, path);
+                pathPos = 0;
+                if (pathLength <= 0) return INPUT_NONE;
+            }
+            unsigned input = path[pathPos++];
+            expectedY = piece.y + (input == INPUT_SOFT_DROP ? 1 : 0);
+            return input;
+        }
+
+        // Drops the rest of the current path, e.g. after a restart
+        void reset() { pathLength = pathPos = 0; }
+
+        const Planner &getPlanner() const { return planner; }
+    };
+}
+
+// ============================================================================
+// REPLAY MODULE (Binary Replays)
+// ============================================================================
+
+// Layout, little-endian:
+//   header  "TRPL" version:u8 mode:u8 reserved:u16 tickUs:u32 seed:u64
+//   events  varint(ticks since the previous event) input:u8, input != 0
+//   end     varint(ticks since the previous event) 0x00
+//   footer  score:u32 lines:u32 pieces:u32
+// An event at tick T is Game::step(input, 0) after T ticks of
+// step(INPUT_NONE, tickUs), so a replay is the seed plus the input stream.
+namespace Replay {
+    using namespace GameEngine;
+
+    const uint8_t MAGIC[4] = {'T', 'R', 'P', 'L'};
+    const uint8_t VERSION = 1;
+    const size_t HEADER_SIZE = 20;
+    const size_t FOOTER_SIZE = 12;
+    const size_t MAX_VARINT = 10;
+
+    struct Header {
+        uint64_t seed;
+        Randomizer mode;
+        uint32_t tickUs;
+    };
+
+    struct Footer {
+        uint32_t score;
+        uint32_t lines;
+        uint32_t pieces;
+
+        bool operator==(const Footer &o) const {
+            return score == o.score && lines == o.lines && pieces == o.pieces;
+        }
+    };
+
+    inline void putU32(uint8_t *p, uint32_t v) {
+        for (int i = 0; i < 4; i++)
+            p[i] = (uint8_t)(v >> (8 * i));
+    }
+
+    inline void putU64(uint8_t *p, uint64_t v) {
+        for (int i = 0; i < 8; i++)
+            p[i] = (uint8_t)(v >> (8 * i));
+    }
+
+    inline uint32_t getU32(const uint8_t *p) {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++)
+            v |= (uint32_t)p[i] << (8 * i);
+        return v;
+    }
+
+    inline uint64_t getU64(const uint8_t *p) {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++)
+            v |= (uint64_t)p[i] << (8 * i);
+        return v;
+    }
+
+    // LEB128: seven bits per byte, high bit set on all but the last
+    inline size_t putVarint(uint8_t *p, uint64_t v) {
+        size_t n = 0;
+        while (v >= 0x80) {
+            p[n++] = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        p[n++] = (uint8_t)v;
+        return n;
+    }
+
+    inline bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+        v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            uint8_t b = *p++;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    inline Footer footerOf(const Game &game) {
+        return Footer{(uint32_t)game.getBoard().getScore(), (uint32_t)game.getBoard().getLinesClearedTotal(),
+                      (uint32_t)game.getPiecesPlaced()};
+    }
+
+    // Double-buffered file writer. The game thread appends to the front
+    // buffer; once it holds a block, it is handed to a writer thread if
+    // that thread is idle. If it is still busy the front buffer just keeps
+    // growing, so write() never waits on the disk.
+    class AsyncWriter {
+    private:
+        FILE *file;
+        size_t blockSize;
+        vector<uint8_t> front, back;
+        mutex lock;
+        condition_variable wake;
+        bool backPending;
+        bool stopping;
+        bool failed;                    // A block did not reach the file (disk full, I/O error)
+        atomic<long> blocksWritten;     // Bumped by the writer thread, read from any thread
+        thread worker;
+
+        void run() {
+            unique_lock<mutex> guard(lock);
+            while (true) {
+                wake.wait(guard, [&] { return backPending || stopping; });
+                if (backPending) {
+                    guard.unlock();
+                    bool written = fwrite(back.data(), 1, back.size(), file) == back.size();
+                    back.clear();
+                    guard.lock();
+                    if (!written)
+                        failed = true;
+                    backPending = false;
+                    blocksWritten++;
+                    wake.notify_all();
+                } else if (stopping) {
+                    return;
+                }
+            }
+        }
+
+        // Hands the front buffer over unless the writer is busy
+        void tryHandOff() {
+            unique_lock<mutex> guard(lock, try_to_lock);
+            if (!guard.owns_lock() || backPending) return;
+            front.swap(back);
+            backPending = true;
+            wake.notify_one();
+        }
+
+    public:
+        explicit AsyncWriter(const char *path, size_t block = 64 * 1024)
+            : file(fopen(path, "wb")), blockSize(block), backPending(false), stopping(false), failed(false),
+              blocksWritten(0) {
+            front.reserve(2 * blockSize);
+            back.reserve(2 * blockSize);
+            if (file)
+                worker = thread(&AsyncWriter::run, this);
+        }
+
+        ~AsyncWriter() { close(); }
+
+        bool isOpen() const { return file != nullptr; }
+
+        // Does nothing if the file could not be opened, so nothing piles up
+        void write(const uint8_t *data, size_t n) {
+            if (!file) return;
+            front.insert(front.end(), data, data + n);
+            if (front.size() >= blockSize)
+                tryHandOff();
+        }
+
+        // Writes whatever is buffered and closes the file; blocks. False if
+        // any of it failed to reach the file, which is then incomplete.
+        bool close() {
+            if (!file) return false;
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&] { return !backPending; });
+                front.swap(back);
+                backPending = !back.empty();
+                stopping = true;
+                wake.notify_all();
+            }
+            worker.join();
+            bool ok = !failed && !ferror(file);
+            if (fclose(file) != 0)
+                ok = false;
+            file = nullptr;
+            return ok;
+        }
+
+        long getBlocksWritten() const { return blocksWritten; }
+    };
+
+    // Streams one game into a replay file. Start it right after the Game
+    // is created or reset, so the header seed reproduces the piece queue.
+    class Recorder {
+    private:
+        AsyncWriter writer;
+        int64_t lastTick;
+        long events;
+
+    public:
+        Recorder(const char *path, const Game &game, uint32_t tickUs) : writer(path), lastTick(0), events(0) {
+            uint8_t header[HEADER_SIZE] = {};
+            memcpy(header, MAGIC, 4);
+            header[4] = VERSION;
+            header[5] = (uint8_t)game.getRandomizer();
+            putU32(header + 8, tickUs);
+            putU64(header + 12, game.getSeed());
+            writer.write(header, sizeof(header));
+        }
+
+        bool isOpen() const { return writer.isOpen(); }
+
+        void record(int64_t tick, unsigned inputs) {
+            if (!inputs) return;
+            uint8_t event[MAX_VARINT + 1];
+            size_t n = putVarint(event, (uint64_t)(tick - lastTick));
+            event[n++] = (uint8_t)inputs;
+            lastTick = tick;
+            writer.write(event, n);
+            events++;
+        }
+
+        bool finish(int64_t tick, const Game &game) {
+            uint8_t tail[MAX_VARINT + 1 + FOOTER_SIZE];
+            size_t n = putVarint(tail, (uint64_t)(tick - lastTick));
+            tail[n++] = 0;
+            Footer footer = footerOf(game);
+            putU32(tail + n, footer.score);
+            putU32(tail + n + 4, footer.lines);
+            putU32(tail + n + 8, footer.pieces);
+            writer.write(tail, n + FOOTER_SIZE);
+            return writer.close();
+        }
+
+        long getEvents() const { return events; }
+    };
+
+    // Read-only view of a replay file through mmap; nothing is copied
+    class MappedReplay {
+    private:
+        const uint8_t *data;
+        size_t size;
+        Header header;
+
+    public:
+        MappedReplay() : data(nullptr), size(0), header() {}
+        MappedReplay(const MappedReplay &) = delete;
+        MappedReplay &operator=(const MappedReplay &) = delete;
+        ~MappedReplay() { close(); }
+
+        bool open(const char *path) {
+            close();
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size >= HEADER_SIZE + 2 + FOOTER_SIZE;
+            if (ok) {
+                void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    data = (const uint8_t *)p;
+                    size = (size_t)st.st_size;
+                }
+            }
+            ::close(fd);
+            if (!data) return false;
+
+            if (memcmp(data, MAGIC, 4) != 0 || data[4] != VERSION || data[5] > RANDOMIZER_BAG7) {
+                close();
+                return false;
+            }
+            header.mode = (Randomizer)data[5];
+            header.tickUs = getU32(data + 8);
+            header.seed = getU64(data + 12);
+            return true;
+        }
+
+        void close() {
+            if (data)
+                munmap((void *)data, size);
+            data = nullptr;
+            size = 0;
+        }
+
+        const Header &getHeader() const { return header; }
+        const uint8_t *begin() const { return data + HEADER_SIZE; }
+        const uint8_t *end() const { return data + size; }
+        size_t getSize() const { return size; }
+    };
+
+    struct VerifyResult {
+        bool ok;
+        long events;
+        int64_t ticks;
+        Footer expected, actual;
+    };
+
+    // Re-simulates the replay on game (reset to the header's seed). Runs of
+    // empty ticks collapse into one step(INPUT_NONE, k * tickUs), which
+    // Game's gravity accumulator makes equivalent to k separate ticks.
+    inline VerifyResult resimulate(const MappedReplay &replay, Game &game) {
+        VerifyResult result = {};
+        const Header &h = replay.getHeader();
+        game.reset(h.seed, h.mode);
+
+        const uint8_t *p = replay.begin();
+        const uint8_t *end = replay.end();
+        while (true) {
+            uint64_t delta;
+            if (!getVarint(p, end, delta) || p >= end) return result;
+            uint8_t input = *p++;
+            if (delta)
+                game.step(INPUT_NONE, (int64_t)delta * h.tickUs);
+            result.ticks += (int64_t)delta;
+            if (!input) break;
+            game.step(input, 0);
+            result.events++;
+        }
+        if ((size_t)(end - p) != FOOTER_SIZE) return result;
+        result.expected = Footer{getU32(p), getU32(p + 4), getU32(p + 8)};
+        result.actual = footerOf(game);
+        result.ok = result.expected == result.actual;
+        return result;
+    }
+
+    // Like resimulate, but one tick at a time: onTick(tick) sees the game
+    // once every input of that tick is applied, for every tick up to the end.
+    template <class OnTick>
+    VerifyResult playback(const MappedReplay &replay, Game &game, OnTick onTick) {
+        VerifyResult result = {};
+        const Header &h = replay.getHeader();
+        game.reset(h.seed, h.mode);
+
+        const uint8_t *p = replay.begin();
+        const uint8_t *end = replay.end();
+        while (true) {
+            uint64_t delta;
+            if (!getVarint(p, end, delta) || p >= end) return result;
+            uint8_t input = *p++;
+            for (uint64_t i = 0; i < delta; i++) {
+                onTick(result.ticks++);
+                game.step(INPUT_NONE, h.tickUs);
+            }
+            if (!input) break;
+            game.step(input, 0);
+            result.events++;
+        }
+        onTick(result.ticks);
+        if ((size_t)(end - p) != FOOTER_SIZE) return result;
+        result.expected = Footer{getU32(p), getU32(p + 4), getU32(p + 8)};
+        result.actual = footerOf(game);
+        result.ok = result.expected == result.actual;
+        return result;
+    }
+}
+
+// ============================================================================
+// TEXT MODULE
+// ============================================================================
+
+namespace BlockFont {
+    // Block letters for the GAME OVER banner and the software renderer's
+    // panel, 7x7 cells at one bit per cell: rows[y] bit x is cell (x, y),
+    // y = 0 being the bottom row
+    const int GLYPH_SIZE = 7;
+
+    struct Glyph {
+        uint8_t rows[GLYPH_SIZE];
+    };
+
+    // Indexed by character; characters without art stay blank
+    struct GlyphTable {
+        Glyph glyphs[128];
+    };
+
+    // art is GLYPH_SIZE rows drawn top row first, '#' = filled
+    constexpr Glyph glyphFromArt(initializer_list<const char *> art) {
+        Glyph g{};
+        int y = GLYPH_SIZE - 1;
+        for (const char *row : art) {
+            for (int x = 0; x < GLYPH_SIZE && row[x]; x++) {
+                if (row[x] == '#')
+                    g.rows[y] |= (uint8_t)(1u << x);
+            }
+            y--;
+        }
+        return g;
+    }
+
+    constexpr GlyphTable buildFont() {
+        GlyphTable t{};
+        t.glyphs['G'] = glyphFromArt({
+            ".####..",
+            "#......",
+            "#......",
+            "#.###..",
+            "#...#..",
+            "#...#..",
+            ".####..",
+        });
+        t.glyphs['A'] = glyphFromArt({
+            ".####..",
+            "#....#.",
+            "#....#.",
+            "######.",
+            "#....#.",
+            "#....#.",
+            "#....#.",
+        });
+        t.glyphs['M'] = glyphFromArt({
+            "#.....#",
+            "#.....#",
+            "##...##",
+            "#.#.#.#",
+            "#..#..#",
+            "#.....#",
+            "#.....#",
+        });
+        t.glyphs['E'] = glyphFromArt({
+            "######.",
+            "#......",
+            "#......",
+            "######.",
+            "#......",
+            "#......",
+            "#######",
+        });
+        t.glyphs['O'] = glyphFromArt({
+            ".#####.",
+            "#.....#",
+            "#.....#",
+            "#.....#",
+            "#.....#",
+            "#.....#",
+            ".#####.",
+        });
+        t.glyphs['V'] = glyphFromArt({
+            "#.....#",
+            "#.....#",
+            "#.....#",
+            "#.....#",
+            ".#...#.",
+            "..#.#..",
+            "...#...",
+        });
+        t.glyphs['R'] = glyphFromArt({
+            "####...",
+            "#...#..",
+            "#...#..",
+            "#####..",
+            "#....#.",
+            "#.....#",
+            "#.....#",
+        });
+        t.glyphs['N'] = glyphFromArt({
+            "#.....#",
+            "##....#",
+            "#.#...#",
+            "#..#..#",
+            "#...#.#",
+            "#....##",
+            "#.....#",
+        });
+        t.glyphs['X'] = glyphFromArt({
+            "#.....#",
+            ".#...#.",
+            "..#.#..",
+            "...#...",
+            "..#.#..",
+            ".#...#.",
+            "#.....#",
+        });
+        t.glyphs['T'] = glyphFromArt({
+            "#######",
+            "...#...",
+            "...#...",
+            "...#...",
+            "...#...",
+            "...#...",
+            "...#...",
+        });
+        t.glyphs['S'] = glyphFromArt({
+            ".#####.",
+            "#......",
+            "#......",
+            ".#####.",
+            "......#",
+            "......#",
+            ".#####.",
+        });
+        t.glyphs['C'] = glyphFromArt({
+            ".#####.",
+            "#......",
+            "#......",
+            "#......",
+            "#......",
+            "#......",
+            ".#####.",
+        });
+        t.glyphs['H'] = glyphFromArt({
+            "#.....#",
+            "#.....#",
+            "#.....#",
+            "#######",
+            "#.....#",
+            "#.....#",
+            "#.....#",
+        });
+        t.glyphs['I'] = glyphFromArt({
+            ".#####.",
+            "...#...",
+            "...#...",
+            "...#...",
+            "...#...",
+            "...#...",
+            ".#####.",
+        });
+        t.glyphs['L'] = glyphFromArt({
+            "#......",
+            "#......",
+            "#......",
+            "#......",
+            "#......",
+            "#......",
+            "#######",
+        });
+        t.glyphs['0'] = glyphFromArt({
+            ".#####.",
+            "#....##",
+            "#...#.#",
+            "#..#..#",
+            "#.#...#",
+            "##....#",
+            ".#####.",
+        });
+        t.glyphs['1'] = glyphFromArt({
+            "...#...",
+            "..##...",
+            ".#.#...",
+            "...#...",
+            "...#...",
+            "...#...",
+            ".#####.",
+        });
+        t.glyphs['2'] = glyphFromArt({
+            ".#####.",
+            "#.....#",
+            "......#",
+            "..####.",
+            ".#.....",
+            "#......",
+            "#######",
+        });
+        t.glyphs['3'] = glyphFromArt({
+            ".#####.",
+            "#.....#",
+            "......#",
+            "..####.",
+            "......#",
+            "#.....#",
+            ".#####.",
+        });
+        t.glyphs['4'] = glyphFromArt({
+            "....##.",
+            "...#.#.",
+            "..#..#.",
+            ".#...#.",
+            "#######",
+            ".....#.",
+            ".....#.",
+        });
+        t.glyphs['5'] = glyphFromArt({
+            "#######",
+            "#......",
+            "######.",
+            "......#",
+            "......#",
+            "#.....#",
+            ".#####.",
+        });
+        t.glyphs['6'] = glyphFromArt({
+            ".#####.",
+            "#......",
+            "#......",
+            "######.",
+            "#.....#",
+            "#.....#",
+            ".#####.",
+        });
+        t.glyphs['7'] = glyphFromArt({
+            "#######",
+            "......#",
+            ".....#.",
+            "....#..",
+            "...#...",
+            "...#...",
+            "...#...",
+        });
+        t.glyphs['8'] = glyphFromArt({
+            ".#####.",
+            "#.....#",
+            "#.....#",
+            ".#####.",
+            "#.....#",
+            "#.....#",
+            ".#####.",
+        });
+        t.glyphs['9'] = glyphFromArt({
+            ".#####.",
+            "#.....#",
+            "#.....#",
+            ".######",
+            "......#",
+            "......#",
+            ".#####.",
+        });
+        return t;
+    }
+
+    constexpr GlyphTable FONT = buildFont();
+
+    constexpr const Glyph &glyph(char c) {
+        return FONT.glyphs[(unsigned char)c & 127];
+    }
+
+    // Filled cells in a string, for sizing vertex arrays at compile time
+    constexpr int cellCount(const char *text) {
+        int n = 0;
+        for (; *text; text++) {
+            for (int y = 0; y < GLYPH_SIZE; y++) {
+                for (uint8_t bits = glyph(*text).rows[y]; bits; bits &= (uint8_t)(bits - 1))
+                    n++;
+            }
+        }
+        return n;
+    }
+}
+
+// ============================================================================
+// SOFTWARE RENDERER MODULE (CPU Rasterizer, Image Output)
+// ============================================================================
+
+// The GameRenderer picture drawn on the CPU, for thumbnails and clips on
+// machines with no display or GL. Frames are rasterized straight into the
+// bytes that get written out: a raw rgb24 buffer, or the scanlines inside
+// an uncompressed PNG.
+namespace SoftRender {
+    using namespace Config;
+    using namespace Color;
+    using namespace Tetromino;
+    using namespace Board;
+
+    struct RGB8 {
+        uint8_t r, g, b;
+    };
+
+    inline RGB8 toRGB8(const RGB &c, float shade = 1.0f) {
+        return RGB8{(uint8_t)(c.r * shade * 255.0f + 0.5f), (uint8_t)(c.g * shade * 255.0f + 0.5f),
+                    (uint8_t)(c.b * shade * 255.0f + 0.5f)};
+    }
+
+    // Writable view of 24-bit pixels owned by someone else, rows top-down
+    // and stride bytes apart
+    class Canvas {
+    private:
+        uint8_t *pixels;
+        int width, height;
+        size_t stride;
+
+    public:
+        Canvas(uint8_t *p, int w, int h, size_t rowStride) : pixels(p), width(w), height(h), stride(rowStride) {}
+
+        // Fills [x0, x1) x [y0, y1), clipped to the canvas
+        void fill(int x0, int y0, int x1, int y1, RGB8 c) {
+            x0 = max(x0, 0);
+            y0 = max(y0, 0);
+            x1 = min(x1, width);
+            y1 = min(y1, height);
+            if (x0 >= x1 || y0 >= y1) return;
+
+            uint8_t *first = pixels + (size_t)y0 * stride + 3 * (size_t)x0;
+            for (int x = 0; x < x1 - x0; x++) {
+                first[3 * x] = c.r;
+                first[3 * x + 1] = c.g;
+                first[3 * x + 2] = c.b;
+            }
+            size_t bytes = 3 * (size_t)(x1 - x0);
+            for (int y = y0 + 1; y < y1; y++)
+                memcpy(pixels + (size_t)y * stride + 3 * (size_t)x0, first, bytes);
+        }
+
+        void outline(int x0, int y0, int x1, int y1, RGB8 c) {
+            fill(x0, y0, x1, y0 + 1, c);
+            fill(x0, y1 - 1, x1, y1, c);
+            fill(x0, y0, x0 + 1, y1, c);
+            fill(x1 - 1, y0, x1, y1, c);
+        }
+
+        // BlockFont text with (x, y) the top-left corner and each glyph cell
+        // scale x scale pixels
+        void text(int x, int y, const char *s, int scale, RGB8 c) {
+            using BlockFont::GLYPH_SIZE;
+            for (; *s; s++, x += (GLYPH_SIZE + 1) * scale) {
+                const BlockFont::Glyph &g = BlockFont::glyph(*s);
+                for (int gy = 0; gy < GLYPH_SIZE; gy++) {
+                    int py = y + (GLYPH_SIZE - 1 - gy) * scale;
+                    for (int gx = 0; gx < GLYPH_SIZE; gx++) {
+                        if (g.rows[gy] >> gx & 1)
+                            fill(x + gx * scale, py, x + (gx + 1) * scale, py + scale, c);
+                    }
+                }
+            }
+        }
+    };
+
+    // Board cell as a block: a fill inset from the grid with a dark outline
+    inline void drawBlock(Canvas &canvas, int cx, int cy, RGB8 fill, bool outlined) {
+        const int pad = 2;
+        int x = cx * CELL, y = cy * CELL;
+        canvas.fill(x + pad, y + pad, x + CELL - pad, y + CELL - pad, fill);
+        if (outlined)
+            canvas.outline(x + pad, y + pad, x + CELL - pad, y + CELL - pad, toRGB8(RGB(0.1f, 0.1f, 0.1f)));
+    }
+
+    // The GameRenderer layout at a tick boundary (no interpolation), with
+    // the panel in block letters and without the controls help
+    inline void drawFrame(Canvas &canvas, const GameEngine::Game &game) {
+        const GameBoard &board = game.getBoard();
+        const Piece &piece = game.getCurrentPiece();
+
+        canvas.fill(0, 0, WINDOW_W, WINDOW_H, RGB8{0, 0, 0});
+        canvas.fill(0, 0, BOARD_W * CELL, BOARD_H * CELL, toRGB8(RGB(0.05f, 0.05f, 0.05f)));
+        const RGB8 grid = toRGB8(RGB(0.15f, 0.15f, 0.15f));
+        for (int i = 0; i <= BOARD_W; i++)
+            canvas.fill(i * CELL - 1, 0, i * CELL, BOARD_H * CELL, grid);
+        for (int i = 0; i <= BOARD_H; i++)
+            canvas.fill(0, i * CELL, BOARD_W * CELL, i * CELL + 1, grid);
+
+        for (int y = 0; y < BOARD_H; y++) {
+            if (!board.getRow(y)) continue;
+            const uint8_t *colors = board.getColorRow(y);
+            for (int x = 0; x < BOARD_W; x++) {
+                if (int color = colorAt(colors, x))
+                    drawBlock(canvas, x, y, toRGB8(getColorRGB(color)), true);
+            }
+        }
+
+        int ghostDrop = board.dropDistance(piece);
+        for (const auto &pos : piece.getWorldPositions()) {
+            int x = (int)pos.x, y = (int)pos.y;
+            if (ghostDrop > 0 && y + ghostDrop >= 0)
+                drawBlock(canvas, x, y + ghostDrop, toRGB8(getColorRGB(piece.colorIndex), GHOST_SHADE), false);
+        }
+        for (const auto &pos : piece.getWorldPositions()) {
+            int x = (int)pos.x, y = (int)pos.y;
+            if (y >= 0 && y < BOARD_H)
+                drawBlock(canvas, x, y, toRGB8(getColorRGB(piece.colorIndex)), true);
+        }
+
+        // Side panel: preview, then the three counters as label over value
+        const int panelX = BOARD_W * CELL + (int)PANEL_X_OFFSET;
+        const int scale = 2;
+        const RGB8 white{255, 255, 255};
+        canvas.text(panelX, 6, "NEXT", scale, white);
+
+        const Piece &next = game.getNextPiece();
+        const int s = (int)PANEL_PREVIEW_SCALE;
+        for (const auto &local : next.state().cells) {
+            int x = panelX + 20 + (int)((local.x + 1.5f) * s);
+            int y = 52 + (int)((local.y + 0.5f) * s);
+            canvas.fill(x, y, x + s - 2, y + s - 2, toRGB8(getColorRGB(next.colorIndex)));
+        }
+
+        const char *labels[3] = {"SCORE", "HIGH", "LINES"};
+        const int values[3] = {board.getScore(), board.getHighScore(), board.getLinesClearedTotal()};
+        for (int i = 0; i < 3; i++) {
+            char number[16];
+            snprintf(number, sizeof(number), "%d", values[i]);
+            canvas.text(panelX, 130 + 46 * i, labels[i], scale, white);
+            canvas.text(panelX, 150 + 46 * i, number, scale, white);
+        }
+
+        if (board.isGameOver()) {
+            const int big = 6;
+            const int lineW = 4 * (BlockFont::GLYPH_SIZE + 1) * big - big;
+            const int lineH = BlockFont::GLYPH_SIZE * big;
+            int x = (BOARD_W * CELL - lineW) / 2;
+            int y = BOARD_H * CELL / 2 - lineH - big;
+            canvas.text(x, y, "GAME", big, RGB8{255, 0, 0});
+            canvas.text(x, y + lineH + 2 * big, "OVER", big, RGB8{255, 0, 0});
+        }
+    }
+
+    // Slicing-by-8: entries[k][n] is the CRC of byte n followed by k zero
+    // bytes, so eight input bytes cost eight independent lookups
+    struct CrcTable {
+        uint32_t entries[8][256];
+    };
+
+    constexpr CrcTable buildCrcTable() {
+        CrcTable t{};
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t.entries[0][n] = c;
+        }
+        for (int k = 1; k < 8; k++) {
+            for (int n = 0; n < 256; n++) {
+                uint32_t c = t.entries[k - 1][n];
+                t.entries[k][n] = t.entries[0][c & 0xFF] ^ (c >> 8);
+            }
+        }
+        return t;
+    }
+
+    constexpr CrcTable CRC_TABLE = buildCrcTable();
+
+    // PNG chunk CRC (zlib crc32), continued from crc
+    inline uint32_t crc32(uint32_t crc, const uint8_t *p, size_t n) {
+        const auto &t = CRC_TABLE.entries;
+        crc = ~crc;
+        for (; n >= 8; n -= 8, p += 8) {
+            uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+                  t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        }
+        for (; n; n--, p++)
+            crc = t[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    inline void putU32BE(uint8_t *p, uint32_t v) {
+        for (int i = 0; i < 4; i++)
+            p[i] = (uint8_t)(v >> (24 - 8 * i));
+    }
+
+    // An RGB PNG whose zlib stream is "stored" (uncompressed) deflate
+    // blocks, one per scanline. Every row then sits at a fixed stride
+    // inside the file, so the canvas draws directly into it and a frame
+    // costs only the Adler-32 and CRC passes before it can be written out.
+    // A stored block holds at most 65535 bytes, which caps the width.
+    class PngImage {
+    public:
+        static const int MAX_WIDTH = (65535 - 1) / 3;
+
+    private:
+        static const size_t SIGNATURE_SIZE = 8;
+        static const size_t IHDR_SIZE = 12 + 13;
+        static const size_t BLOCK_HEADER = 5;
+
+        vector<uint8_t> bytes;
+        int width, height;
+        size_t rowBytes;            // Filter byte plus pixels
+        size_t stride;
+        size_t idatStart;           // Offset of the IDAT chunk's type field
+        size_t firstRow;            // Offset of row 0's filter byte
+
+    public:
+        PngImage(int w, int h)
+            : width(w), height(h), rowBytes(1 + 3 * (size_t)w), stride(BLOCK_HEADER + rowBytes) {
+            if (w <= 0 || w > MAX_WIDTH || h <= 0) return;
+            size_t idatData = 2 + stride * h + 4;
+            bytes.assign(SIGNATURE_SIZE + IHDR_SIZE + 12 + idatData + 12, 0);
+            uint8_t *p = bytes.data();
+
+            const uint8_t signature[SIGNATURE_SIZE] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+            memcpy(p, signature, SIGNATURE_SIZE);
+            p += SIGNATURE_SIZE;
+
+            putU32BE(p, 13);
+            memcpy(p + 4, "IHDR", 4);
+            putU32BE(p + 8, (uint32_t)w);
+            putU32BE(p + 12, (uint32_t)h);
+            p[16] = 8;              // Bit depth
+            p[17] = 2;              // Truecolour RGB
+            putU32BE(p + 21, crc32(0, p + 4, 17));
+            p += IHDR_SIZE;
+
+            putU32BE(p, (uint32_t)idatData);
+            memcpy(p + 4, "IDAT", 4);
+            idatStart = (size_t)(p + 4 - bytes.data());
+            p += 8;
+            p[0] = 0x78;            // zlib: deflate, 32K window, no preset dictionary
+            p[1] = 0x01;
+            p += 2;
+            firstRow = (size_t)(p - bytes.data()) + BLOCK_HEADER;
+            for (int y = 0; y < h; y++, p += stride) {
+                p[0] = y == h - 1 ? 1 : 0;
+                p[1] = (uint8_t)rowBytes;
+                p[2] = (uint8_t)(rowBytes >> 8);
+                p[3] = (uint8_t)~p[1];
+                p[4] = (uint8_t)~p[2];
+            }
+
+            p += 4 + 4;             // Adler-32, then the IDAT CRC
+            memcpy(p + 4, "IEND", 4);
+            putU32BE(p + 8, crc32(0, p + 4, 4));
+        }
+
+        // False if the size was out of range; nothing else may be called then
+        bool isValid() const { return !bytes.empty(); }
+        int getWidth() const { return width; }
+        int getHeight() const { return height; }
+
+        // Pixels of row 0 start right after its filter byte (0, none)
+        Canvas canvas() { return Canvas(bytes.data() + firstRow + 1, width, height, stride); }
+
+        // Fills in the checksums for whatever the canvas drew; the returned
+        // bytes are the complete file
+        const vector<uint8_t> &finish() {
+            // Adler-32 a chunk at a time: over n bytes, a grows by their sum
+            // and b by n * a plus the sum weighted n, n - 1, ..., 1. Both
+            // sums are plain reductions the compiler vectorizes.
+            uint64_t a = 1, b = 0;
+            const uint8_t *row = bytes.data() + firstRow;
+            for (int y = 0; y < height; y++, row += stride) {
+                // Chunks of at most 5552 bytes keep the weighted sum in 32 bits
+                for (size_t done = 0; done < rowBytes;) {
+                    uint32_t n = (uint32_t)min(rowBytes - done, (size_t)5552);
+                    uint32_t sum = 0, weighted = 0;
+                    for (uint32_t i = 0; i < n; i++) {
+                        sum += row[done + i];
+                        weighted += (n - i) * row[done + i];
+                    }
+                    b = (b + n * a + weighted) % 65521;
+                    a = (a + sum) % 65521;
+                    done += n;
+                }
+            }
+            size_t adlerAt = firstRow - BLOCK_HEADER + stride * height;
+            putU32BE(bytes.data() + adlerAt, (uint32_t)(b << 16 | a));
+            putU32BE(bytes.data() + adlerAt + 4, crc32(0, bytes.data() + idatStart, adlerAt + 4 - idatStart));
+            return bytes;
+        }
+    };
+}
+
+#ifndef TETRIS_HEADLESS
+
+// ============================================================================
+// GL EXTENSIONS MODULE (Runtime Capability Checks)
+// ============================================================================
+
+// Buffer objects (GL 1.5 / ARB_vertex_buffer_object) and framebuffer
+// objects (GL 3.0 / ARB_framebuffer_object) are not in every context the
+// front-end may be given, so their entry points are looked up once a
+// context is current instead of being linked directly. When they are
+// missing the renderer stays on its immediate-mode and full-redraw paths.
+namespace GLExt {
+    PFNGLGENBUFFERSPROC genBuffers = nullptr;
+    PFNGLBINDBUFFERPROC bindBuffer = nullptr;
+    PFNGLBUFFERDATAPROC bufferData = nullptr;
+    PFNGLBUFFERSUBDATAPROC bufferSubData = nullptr;
+
+    PFNGLGENFRAMEBUFFERSPROC genFramebuffers = nullptr;
+    PFNGLBINDFRAMEBUFFERPROC bindFramebuffer = nullptr;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus = nullptr;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC framebufferRenderbuffer = nullptr;
+    PFNGLGENRENDERBUFFERSPROC genRenderbuffers = nullptr;
+    PFNGLBINDRENDERBUFFERPROC bindRenderbuffer = nullptr;
+    PFNGLRENDERBUFFERSTORAGEPROC renderbufferStorage = nullptr;
+    PFNGLBLITFRAMEBUFFERPROC blitFramebuffer = nullptr;
+
+    bool hasBuffers = false;
+    bool hasFramebuffers = false;       // Including glBlitFramebuffer
+
+    // GL_VERSION as major * 10 + minor, 0 if there is no current context
+    inline int version() {
+        const char *s = (const char *)glGetString(GL_VERSION);
+        int major = 0, minor = 0;
+        if (!s || sscanf(s, "%d.%d", &major, &minor) != 2) return 0;
+        return major * 10 + minor;
+    }
+
+    inline bool hasExtension(const char *name) {
+        const char *all = (const char *)glGetString(GL_EXTENSIONS);
+        size_t n = strlen(name);
+        for (const char *p = all; p && (p = strstr(p, name)); p += n) {
+            if ((p == all || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0'))
+                return true;
+        }
+        return false;
+    }
+
+    // The core name, or the extension's suffixed one on older contexts
+    template <class Fn, class GetProc>
+    bool resolve(Fn &fn, GetProc getProc, const char *name, const char *fallback) {
+        fn = (Fn)getProc(name);
+        if (!fn && fallback)
+            fn = (Fn)getProc(fallback);
+        return fn != nullptr;
+    }
+
+    // getProc is glutGetProcAddress, eglGetProcAddress or the like; call
+    // with a context current, before the first frame
+    template <class GetProc>
+    void init(GetProc getProc) {
+        int v = version();
+        hasBuffers = (v >= 15 || hasExtension("GL_ARB_vertex_buffer_object")) &&
+                     resolve(genBuffers, getProc, "glGenBuffers", "glGenBuffersARB") &&
+                     resolve(bindBuffer, getProc, "glBindBuffer", "glBindBufferARB") &&
+                     resolve(bufferData, getProc, "glBufferData", "glBufferDataARB") &&
+                     resolve(bufferSubData, getProc, "glBufferSubData", "glBufferSubDataARB");
+        hasFramebuffers = (v >= 30 || hasExtension("GL_ARB_framebuffer_object")) &&
+                          resolve(genFramebuffers, getProc, "glGenFramebuffers", nullptr) &&
+                          resolve(bindFramebuffer, getProc, "glBindFramebuffer", nullptr) &&
+                          resolve(checkFramebufferStatus, getProc, "glCheckFramebufferStatus", nullptr) &&
+                          resolve(framebufferRenderbuffer, getProc, "glFramebufferRenderbuffer", nullptr) &&
+                          resolve(genRenderbuffers, getProc, "glGenRenderbuffers", nullptr) &&
+                          resolve(bindRenderbuffer, getProc, "glBindRenderbuffer", nullptr) &&
+                          resolve(renderbufferStorage, getProc, "glRenderbufferStorage", nullptr) &&
+                          resolve(blitFramebuffer, getProc, "glBlitFramebuffer", nullptr);
+    }
+
+    // For GLUTs without glutGetProcAddress: nothing optional is used
+    inline void (*noProcAddress(const char *))() { return nullptr; }
+}
+
+// ============================================================================
+// RENDERER MODULE
+// ============================================================================
+
+namespace Renderer {
+    using namespace Config;
+    using namespace Color;
+    using namespace Tetromino;
+    using namespace Board;
+    using namespace Math;
+
+    struct Vertex {
+        float x, y;
+        float r, g, b;
+    };
+
+    // The whole board in one persistent vertex buffer, split into a quad
+    // range (background, grid, cell fills) and a line range (cell outlines).
+    // The static part is re-uploaded only when the board revision changes;
+    // the active piece is appended after it every frame. Drawing is one
+    // glDrawArrays per range.
+    class BoardMesh {
+    private:
+        static const int MAX_CELLS = BOARD_W * BOARD_H + 2 * PIECE_BLOCKS;
+        static const int QUAD_CAPACITY = 4 * (1 + (BOARD_W + 1) + (BOARD_H + 1) + MAX_CELLS);
+        static const int LINE_CAPACITY = 8 * MAX_CELLS;
+
+        GLuint vbo;
+        Vertex quads[QUAD_CAPACITY];
+        Vertex lines[LINE_CAPACITY];
+        int quadCount, lineCount;
+        int staticQuads, staticLines;
+        uint32_t builtRevision;
+        bool built;
+
+        void addQuad(float x0, float y0, float x1, float y1, const RGB &c) {
+            Vertex *v = &quads[quadCount];
+            v[0] = Vertex{x0, y0, c.r, c.g, c.b};
+            v[1] = Vertex{x1, y0, c.r, c.g, c.b};
+            v[2] = Vertex{x1, y1, c.r, c.g, c.b};
+            v[3] = Vertex{x0, y1, c.r, c.g, c.b};
+            quadCount += 4;
+        }
+
+        void addOutline(float x0, float y0, float x1, float y1, const RGB &c) {
+            const float xs[4] = {x0, x1, x1, x0};
+            const float ys[4] = {y0, y0, y1, y1};
+            for (int i = 0; i < 4; i++) {
+                int j = (i + 1) & 3;
+                lines[lineCount++] = Vertex{xs[i], ys[i], c.r, c.g, c.b};
+                lines[lineCount++] = Vertex{xs[j], ys[j], c.r, c.g, c.b};
+            }
+        }
+
+        void buildStatic(const GameBoard &board) {
+            quadCount = lineCount = 0;
+
+            addQuad(0, 0, BOARD_W * CELL, BOARD_H * CELL, RGB(0.05f, 0.05f, 0.05f));
+
+            // Grid lines as 1px quads so they stay underneath the cells
+            const RGB grid(0.15f, 0.15f, 0.15f);
+            for (int i = 0; i <= BOARD_W; i++)
+                addQuad(i * CELL - 0.5f, 0, i * CELL + 0.5f, BOARD_H * CELL, grid);
+            for (int i = 0; i <= BOARD_H; i++)
+                addQuad(0, i * CELL - 0.5f, BOARD_W * CELL, i * CELL + 0.5f, grid);
+
+            for (int y = 0; y < BOARD_H; y++) {
+                const uint8_t *colors = board.getColorRow(y);
+                for (RowMask mask = board.getRow(y); mask; mask &= (RowMask)(mask - 1)) {
+                    int x = __builtin_ctz(mask);
+                    addBlock(Vec2((float)x, (float)y), colorAt(colors, x));
+                }
+            }
+
+            staticQuads = quadCount;
+            staticLines = lineCount;
+            GLExt::bufferSubData(GL_ARRAY_BUFFER, 0, staticQuads * sizeof(Vertex), quads);
+            GLExt::bufferSubData(GL_ARRAY_BUFFER, QUAD_CAPACITY * sizeof(Vertex),
+                            staticLines * sizeof(Vertex), lines);
+            builtRevision = board.getRevision();
+            built = true;
+        }
+
+    public:
+        BoardMesh() : vbo(0), quadCount(0), lineCount(0), staticQuads(0), staticLines(0),
+                      builtRevision(0), built(false) {}
+
+        // Same layout as GameRenderer::drawBlockAt
+        void addBlock(const Vec2 &worldPos, int colorIdx) {
+            const float pad = 1.5f;
+            float x = worldPos.x * CELL;
+            float y = (BOARD_H - worldPos.y) * CELL;
+            addQuad(x + pad, y - CELL + pad, x + CELL - pad, y - pad, getColorRGB(colorIdx));
+            addOutline(x + pad, y - CELL + pad, x + CELL - pad, y - pad, RGB(0.1f, 0.1f, 0.1f));
+        }
+
+        // Landing preview: a dimmed fill without an outline
+        void addGhost(const Vec2 &worldPos, int colorIdx) {
+            const float pad = 1.5f;
+            float x = worldPos.x * CELL;
+            float y = (BOARD_H - worldPos.y) * CELL;
+            RGB c = getColorRGB(colorIdx);
+            addQuad(x + pad, y - CELL + pad, x + CELL - pad, y - pad,
+                    RGB(c.r * GHOST_SHADE, c.g * GHOST_SHADE, c.b * GHOST_SHADE));
+        }
+
+        // Starts a frame: makes sure the static part matches the board and
+        // rewinds the dynamic part so the caller can add the active piece.
+        void begin(const GameBoard &board) {
+            if (!vbo) {
+                GLExt::genBuffers(1, &vbo);
+                GLExt::bindBuffer(GL_ARRAY_BUFFER, vbo);
+                GLExt::bufferData(GL_ARRAY_BUFFER, (QUAD_CAPACITY + LINE_CAPACITY) * sizeof(Vertex),
+                             nullptr, GL_DYNAMIC_DRAW);
+            } else {
+                GLExt::bindBuffer(GL_ARRAY_BUFFER, vbo);
+            }
+            if (!built || builtRevision != board.getRevision())
+                buildStatic(board);
+            quadCount = staticQuads;
+            lineCount = staticLines;
+        }
+
+        void draw() {
+            // Upload only what was added since begin()
+            if (quadCount > staticQuads)
+                GLExt::bufferSubData(GL_ARRAY_BUFFER, staticQuads * sizeof(Vertex),
+                                (quadCount - staticQuads) * sizeof(Vertex), quads + staticQuads);
+            if (lineCount > staticLines)
+                GLExt::bufferSubData(GL_ARRAY_BUFFER, (QUAD_CAPACITY + staticLines) * sizeof(Vertex),
+                                (lineCount - staticLines) * sizeof(Vertex), lines + staticLines);
+
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+
+            glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (const void *)0);
+            glColorPointer(3, GL_FLOAT, sizeof(Vertex), (const void *)(2 * sizeof(float)));
+            glDrawArrays(GL_QUADS, 0, quadCount);
+
+            const size_t lineBase = QUAD_CAPACITY * sizeof(Vertex);
+            glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (const void *)lineBase);
+            glColorPointer(3, GL_FLOAT, sizeof(Vertex), (const void *)(lineBase + 2 * sizeof(float)));
+            glDrawArrays(GL_LINES, 0, lineCount);
+
+            glDisableClientState(GL_COLOR_ARRAY);
+            glDisableClientState(GL_VERTEX_ARRAY);
+            GLExt::bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    };
+
+    // Window-pixel rectangle [x0, x1) x [y0, y1), y up like the projection
+    struct Rect {
+        int x0, y0, x1, y1;
+
+        bool empty() const { return x0 >= x1 || y0 >= y1; }
+        long area() const { return empty() ? 0 : (long)(x1 - x0) * (y1 - y0); }
+        bool operator==(const Rect &o) const { return x0 == o.x0 && y0 == o.y0 && x1 == o.x1 && y1 == o.y1; }
+        bool operator!=(const Rect &o) const { return !(*this == o); }
+
+        Rect unite(const Rect &o) const {
+            if (empty()) return o;
+            if (o.empty()) return *this;
+            return Rect{min(x0, o.x0), min(y0, o.y0), max(x1, o.x1), max(y1, o.y1)};
+        }
+    };
+
+    // Pixels touched by board cells [cx0, cx1] x [cy0, cy1] (board y down),
+    // grown by a pixel for the grid lines straddling the cell edges
+    inline Rect cellRect(float cx0, float cy0, float cx1, float cy1) {
+        return Rect{(int)floorf(cx0 * CELL) - 1, (int)floorf((BOARD_H - cy1 - 1) * CELL) - 1,
+                    (int)ceilf((cx1 + 1) * CELL) + 1, (int)ceilf((BOARD_H - cy0) * CELL) + 1};
+    }
+
+    // A persistent offscreen copy of the window. The real back buffer is
+    // undefined after a swap, so frames are composed here instead: only the
+    // dirty rectangles are cleared and redrawn (scissored), then the whole
+    // image is blitted to whatever framebuffer was bound on entry.
+    class RetainedFrame {
+    private:
+        static const int MAX_RECTS = 8;
+
+        GLuint fbo, color;
+        int width, height;
+        bool valid;
+        bool broken;                // The driver rejected the framebuffer
+        Rect rects[MAX_RECTS];
+        int rectCount;
+        long redrawnPixels, frames, totalPixels;
+
+        void allocate(int w, int h) {
+            if (!fbo) {
+                GLExt::genFramebuffers(1, &fbo);
+                GLExt::genRenderbuffers(1, &color);
+            }
+            GLExt::bindRenderbuffer(GL_RENDERBUFFER, color);
+            GLExt::renderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+            GLExt::bindRenderbuffer(GL_RENDERBUFFER, 0);
+            GLExt::bindFramebuffer(GL_FRAMEBUFFER, fbo);
+            GLExt::framebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+            broken = GLExt::checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE;
+            width = w;
+            height = h;
+            valid = false;
+        }
+
+    public:
+        RetainedFrame() : fbo(0), color(0), width(0), height(0), valid(false), broken(false), rectCount(0),
+                          redrawnPixels(0), frames(0), totalPixels(0) {}
+
+        // Forces the next update to redraw everything
+        void invalidate() { valid = false; }
+        bool isValid() const { return valid; }
+
+        void add(Rect r) {
+            r = Rect{max(r.x0, 0), max(r.y0, 0), min(r.x1, width), min(r.y1, height)};
+            if (r.empty()) return;
+            if (rectCount < MAX_RECTS)
+                rects[rectCount++] = r;
+            else
+                rects[MAX_RECTS - 1] = rects[MAX_RECTS - 1].unite(r);
+        }
+
+        // Redraws the dirty rectangles with draw(rect) and presents the frame.
+        // Sizes to the current viewport, so a resized window starts over.
+        // Returns false, having drawn nothing, when there is no usable
+        // framebuffer object; the caller then has to redraw in full.
+        template <class Draw>
+        bool update(Draw draw) {
+            if (!GLExt::hasFramebuffers || broken)
+                return false;
+            GLint target, viewport[4];
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            if (viewport[2] <= 0 || viewport[3] <= 0)
+                return false;
+            if (!fbo || viewport[2] != width || viewport[3] != height)
+                allocate(viewport[2], viewport[3]);
+            if (broken) {
+                GLExt::bindFramebuffer(GL_FRAMEBUFFER, target);
+                return false;
+            }
+            GLExt::bindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+            if (!valid) {
+                rects[0] = Rect{0, 0, width, height};
+                rectCount = 1;
+                valid = true;
+            }
+
+            redrawnPixels = 0;
+            glEnable(GL_SCISSOR_TEST);
+            for (int i = 0; i < rectCount; i++) {
+                const Rect &r = rects[i];
+                glScissor(r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0);
+                glClear(GL_COLOR_BUFFER_BIT);
+                draw(r);
+                redrawnPixels += r.area();
+            }
+            glDisable(GL_SCISSOR_TEST);
+            rectCount = 0;
+            totalPixels += redrawnPixels;
+            frames++;
+
+            GLExt::bindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+            GLExt::bindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+            GLExt::blitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            GLExt::bindFramebuffer(GL_FRAMEBUFFER, target);
+            return true;
+        }
+
+        long getRedrawnPixels() const { return redrawnPixels; }
+        double getRedrawnPixelsPerFrame() const { return frames ? (double)totalPixels / frames : 0.0; }
+        long getFramePixels() const { return (long)width * height; }
+    };
+
+    // GLUT bitmap text; returns the GL calls it issued (one raster
+    // position plus one glBitmap per character)
+    inline int drawBitmapText(float x, float y, const char *s) {
+        glRasterPos2f(x, y);
+        int calls = 1;
+        for (; *s; s++, calls++)
+            glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *s);
+        return calls;
+    }
+
+    // Side-panel text as display lists. The static labels compile into one
+    // list on first use; each numeric field gets its own list, recompiled
+    // only when its value changes. A frame of panel text is then a few
+    // glCallList calls instead of a glBitmap per character.
+    class PanelText {
+    private:
+        static const int FIELDS = 3;
+
+        GLuint base;                    // base: labels, base + 1 + i: field i
+        bool labelsBuilt;
+        bool fieldBuilt[FIELDS];
+        int values[FIELDS];
+        long rebuilds;
+
+        void ensureLists() {
+            if (!base)
+                base = glGenLists(1 + FIELDS);
+        }
+
+    public:
+        PanelText() : base(0), labelsBuilt(false), fieldBuilt(), values(), rebuilds(0) {}
+
+        // emit issues the labels' GL calls; it only runs while compiling
+        template <class Emit>
+        void drawLabels(Emit emit) {
+            ensureLists();
+            if (!labelsBuilt) {
+                glNewList(base, GL_COMPILE);
+                emit();
+                glEndList();
+                labelsBuilt = true;
+                rebuilds++;
+            }
+            glCallList(base);
+        }
+
+        // "label value" at (x, y) in the current colour
+        void drawField(int field, float x, float y, const char *label, int value) {
+            ensureLists();
+            if (!fieldBuilt[field] || values[field] != value) {
+                char text[32];
+                snprintf(text, sizeof(text), "%s %d", label, value);
+                glNewList(base + 1 + field, GL_COMPILE);
+                drawBitmapText(x, y, text);
+                glEndList();
+                fieldBuilt[field] = true;
+                values[field] = value;
+                rebuilds++;
+            }
+            glCallList(base + 1 + field);
+        }
+
+        // Lists compiled so far: once for the labels, once per value change
+        long getRebuilds() const { return rebuilds; }
+    };
+
+    // The GAME OVER banner as one quad list, tessellated from the glyph
+    // bitmaps on first use and kept in a vertex buffer. The pulse is a
+    // glScalef around the window origin, cells included, so a frame costs
+    // one draw call and no vertex upload.
+    class BannerMesh {
+    private:
+        static constexpr float X = 40.0f;
+        static constexpr float Y = WINDOW_H / 2;
+        static constexpr float GLYPH_CELL = 10.0f;
+        static constexpr float LETTER_SPACING = 70.0f;
+        static constexpr float LINE_SPACING = 80.0f;
+        static const int CELLS = BlockFont::cellCount("GAME") + BlockFont::cellCount("OVER");
+
+        GLuint vbo;
+        bool built;
+        float vertices[CELLS * 4 * 2];
+
+        int addLine(int count, const char *text, float y) {
+            float x = X;
+            for (; *text; text++, x += LETTER_SPACING) {
+                const BlockFont::Glyph &g = BlockFont::glyph(*text);
+                for (int gy = 0; gy < BlockFont::GLYPH_SIZE; gy++) {
+                    for (uint8_t bits = g.rows[gy]; bits; bits &= (uint8_t)(bits - 1)) {
+                        float x0 = x + __builtin_ctz(bits) * GLYPH_CELL;
+                        float y0 = y + gy * GLYPH_CELL;
+                        const float quad[8] = {x0, y0, x0 + GLYPH_CELL, y0,
+                                               x0 + GLYPH_CELL, y0 + GLYPH_CELL, x0, y0 + GLYPH_CELL};
+                        memcpy(&vertices[count * 8], quad, sizeof(quad));
+                        count++;
+                    }
+                }
+            }
+            return count;
+        }
+
+        void build() {
+            int count = addLine(0, "GAME", Y);
+            addLine(count, "OVER", Y - LINE_SPACING);
+            if (GLExt::hasBuffers) {
+                GLExt::genBuffers(1, &vbo);
+                GLExt::bindBuffer(GL_ARRAY_BUFFER, vbo);
+                GLExt::bufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+            }
+            built = true;
+        }
+
+    public:
+        BannerMesh() : vbo(0), built(false) {}
+
+        void draw(float scale) {
+            if (!built)
+                build();
+            else if (vbo)
+                GLExt::bindBuffer(GL_ARRAY_BUFFER, vbo);
+
+            glPushMatrix();
+            glScalef(scale, scale, 1.0f);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            // Without buffer objects the same array is drawn from client memory (GL 1.1)
+            glVertexPointer(2, GL_FLOAT, 0, vbo ? (const void *)0 : vertices);
+            glDrawArrays(GL_QUADS, 0, CELLS * 4);
+            glDisableClientState(GL_VERTEX_ARRAY);
+            glPopMatrix();
+            if (vbo)
+                GLExt::bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    };
+
+    class GameRenderer {
+    private:
+        const GameBoard *board;
+        const Piece *currentPiece;
+        const Piece *nextPiece;
+        Piece interpolateFrom;
+        float interpolateAlpha;
+        mutable BoardMesh mesh;
+        mutable BannerMesh banner;
+        mutable PanelText panelText;
+        mutable long panelCalls;        // GL calls issued by drawSidePanel, summed over frames
+        mutable long panelFrames;
+
+        // Panel layout, top down (window pixels)
+        static constexpr float PANEL_TOP = WINDOW_H - 20;
+        static constexpr float PREVIEW_Y = PANEL_TOP - 30;
+        static constexpr float SCORE_Y = PREVIEW_Y - 100;
+        static constexpr float CONTROLS_Y = SCORE_Y - 80;
+        static constexpr float OVERLAY_Y = CONTROLS_Y - 150;
+        static const int OVERLAY_SIZE = 160;
+
+        // Debug text under the controls, one line per '\n'; empty = hidden
+        char overlay[OVERLAY_SIZE];
+
+        // Dirty-region state: what the retained frame currently shows
+        static const uint8_t SHOWN_GHOST = 0x10;
+        mutable RetainedFrame frame;
+        mutable uint8_t shownCells[BOARD_H][BOARD_W];   // locked colour, or SHOWN_GHOST | colour
+        mutable Rect shownPiece;
+        mutable int shownShape;                         // type * ROTATIONS + rotation
+        mutable int shownNext, shownScore, shownHigh, shownLines;
+        mutable bool shownGameOver;
+        mutable char shownOverlay[OVERLAY_SIZE];
+
+        // Offset of the drawn piece from its logical cells while interpolating
+        Vec2 pieceOffset() const {
+            Vec2 offset(0, 0);
+            const Piece &from = interpolateFrom;
+            if (from.type == currentPiece->type && from.rotation == currentPiece->rotation &&
+                abs(from.x - currentPiece->x) <= 1 && abs(from.y - currentPiece->y) <= 1) {
+                offset.x = (from.x - currentPiece->x) * (1.0f - interpolateAlpha);
+                offset.y = (from.y - currentPiece->y) * (1.0f - interpolateAlpha);
+            }
+            return offset;
+        }
+
+        // Pixels covered by the active piece as drawBoard places it this frame
+        Rect pieceRect() const {
+            Vec2 offset = pieceOffset();
+            Rect r{0, 0, 0, 0};
+            for (const auto &cellPos : currentPiece->getWorldPositions()) {
+                Vec2 pos = cellPos + offset;
+                r = r.unite(cellRect(pos.x, pos.y, pos.x, pos.y));
+            }
+            return r;
+        }
+
+        // Compares the game against what the retained frame shows and queues
+        // the rectangles that differ: changed board cells (locks, rows shifted
+        // by a line clear, the ghost), the piece's old and new pixels, and the
+        // preview and score fields when withPanel is set.
+        void markDirty(bool withPanel) const {
+            uint8_t cells[BOARD_H][BOARD_W];
+            for (int y = 0; y < BOARD_H; y++) {
+                const uint8_t *colors = board->getColorRow(y);
+                for (int x = 0; x < BOARD_W; x++)
+                    cells[y][x] = (uint8_t)colorAt(colors, x);
+            }
+            int ghostDrop = board->dropDistance(*currentPiece);
+            if (ghostDrop > 0) {
+                for (const auto &cellPos : currentPiece->getWorldPositions()) {
+                    int x = (int)cellPos.x, y = (int)cellPos.y + ghostDrop;
+                    if (y >= 0 && y < BOARD_H)
+                        cells[y][x] = SHOWN_GHOST | (uint8_t)currentPiece->colorIndex;
+                }
+            }
+            Rect piece = pieceRect();
+            int shape = currentPiece->type * ROTATIONS + currentPiece->rotation;
+            bool gameOver = board->isGameOver();
+
+            // The banner pulses over everything, so game over repaints in full
+            if (!frame.isValid() || gameOver || gameOver != shownGameOver) {
+                frame.invalidate();
+            } else {
+                int minX = BOARD_W, maxX = -1, minY = BOARD_H, maxY = -1;
+                for (int y = 0; y < BOARD_H; y++) {
+                    if (!memcmp(cells[y], shownCells[y], BOARD_W)) continue;
+                    minY = min(minY, y);
+                    maxY = y;
+                    for (int x = 0; x < BOARD_W; x++) {
+                        if (cells[y][x] != shownCells[y][x]) {
+                            minX = min(minX, x);
+                            maxX = max(maxX, x);
+                        }
+                    }
+                }
+                if (maxY >= 0)
+                    frame.add(cellRect((float)minX, (float)minY, (float)maxX, (float)maxY));
+                // A new piece can spawn with the old one's bounds but not its cells
+                if (piece != shownPiece || shape != shownShape) {
+                    frame.add(shownPiece);
+                    frame.add(piece);
+                }
+
+                if (withPanel) {
+                    float panelX = BOARD_W * CELL + PANEL_X_OFFSET;
+                    if (nextPiece->type != shownNext)
+                        frame.add(Rect{(int)panelX, (int)(PREVIEW_Y - 5 * PANEL_PREVIEW_SCALE),
+                                       WINDOW_W, (int)(PREVIEW_Y + PANEL_PREVIEW_SCALE)});
+                    if (board->getScore() != shownScore || board->getHighScore() != shownHigh ||
+                        board->getLinesClearedTotal() != shownLines)
+                        frame.add(Rect{(int)panelX, (int)(SCORE_Y - 44), WINDOW_W, (int)(SCORE_Y + 14)});
+                    if (strcmp(overlay, shownOverlay) != 0)
+                        frame.add(Rect{(int)panelX, 0, WINDOW_W, (int)(OVERLAY_Y + 14)});
+                }
+            }
+
+            memcpy(shownCells, cells, sizeof(cells));
+            shownPiece = piece;
+            shownShape = shape;
+            shownNext = nextPiece->type;
+            shownScore = board->getScore();
+            shownHigh = board->getHighScore();
+            shownLines = board->getLinesClearedTotal();
+            shownGameOver = gameOver;
+            memcpy(shownOverlay, overlay, OVERLAY_SIZE);
+        }
+
+    public:
+        GameRenderer(const GameBoard *b, const Piece *curr, const Piece *next) 
+            : board(b), currentPiece(curr), nextPiece(next), interpolateAlpha(1.0f),
+              panelCalls(0), panelFrames(0), shownPiece{0, 0, 0, 0}, shownShape(-1), shownNext(-1),
+              shownScore(0), shownHigh(0), shownLines(0), shownGameOver(false) {
+            overlay[0] = '\0';
+            shownOverlay[0] = '\0';
+        }
+
+        // Shows text (nullptr or "" to hide) at the bottom of the side panel
+        void setOverlay(const char *text) {
+            snprintf(overlay, sizeof(overlay), "%s", text ? text : "");
+        }
+
+        // Draw the current piece this far (0..1) along the way from prev
+        void setInterpolation(const Piece &prev, float alpha) {
+            interpolateFrom = prev;
+            interpolateAlpha = alpha;
+        }
+
+        void drawBlockAt(const Vec2& worldPos, int colorIdx) const {
+            const float pad = 1.5f;
+            float x = worldPos.x * CELL;
+            float y = (BOARD_H - worldPos.y) * CELL;
+
+            setGLColor(colorIdx);
+            glBegin(GL_QUADS);
+            glVertex2f(x + pad, y - CELL + pad);
+            glVertex2f(x + CELL - pad, y - CELL + pad);
+            glVertex2f(x + CELL - pad, y - pad);
+            glVertex2f(x + pad, y - pad);
+            glEnd();
+
+            glColor3f(0.1f, 0.1f, 0.1f);
+            glBegin(GL_LINE_LOOP);
+            glVertex2f(x + pad, y - CELL + pad);
+            glVertex2f(x + CELL - pad, y - CELL + pad);
+            glVertex2f(x + CELL - pad, y - pad);
+            glVertex2f(x + pad, y - pad);
+            glEnd();
+        }
+
+        void drawGhostAt(const Vec2& worldPos, int colorIdx) const {
+            const float pad = 1.5f;
+            float x = worldPos.x * CELL;
+            float y = (BOARD_H - worldPos.y) * CELL;
+
+            RGB c = getColorRGB(colorIdx);
+            glColor3f(c.r * GHOST_SHADE, c.g * GHOST_SHADE, c.b * GHOST_SHADE);
+            glBegin(GL_QUADS);
+            glVertex2f(x + pad, y - CELL + pad);
+            glVertex2f(x + CELL - pad, y - CELL + pad);
+            glVertex2f(x + CELL - pad, y - pad);
+            glVertex2f(x + pad, y - pad);
+            glEnd();
+        }
+
+        // Batched path: the whole board in two draw calls (immediate mode
+        // when the context has no buffer objects)
+        void drawBoard() const {
+            PROFILE_SCOPE(ZONE_DRAW_BOARD);
+            if (!GLExt::hasBuffers) {
+                drawBoardImmediate();
+                return;
+            }
+            mesh.begin(*board);
+
+            int ghostDrop = board->dropDistance(*currentPiece);
+            for (const auto &cellPos : currentPiece->getWorldPositions()) {
+                Vec2 pos = cellPos + Vec2(0, (float)ghostDrop);
+                if (ghostDrop > 0 && pos.y >= 0)
+                    mesh.addGhost(pos, currentPiece->colorIndex);
+            }
+
+            Vec2 offset = pieceOffset();
+            for (const auto &cellPos : currentPiece->getWorldPositions()) {
+                Vec2 pos = cellPos + offset;
+                if (pos.y >= 0 && pos.y < BOARD_H && pos.x >= (-0.01f)&& pos.x < BOARD_W)
+                    mesh.addBlock(pos, currentPiece->colorIndex);
+            }
+            mesh.draw();
+        }
+
+        // Reference immediate-mode path, kept for the render benchmark
+        void drawBoardImmediate() const {
+            // Background
+            glColor3f(0.05f, 0.05f, 0.05f);
+            glBegin(GL_QUADS);
+            glVertex2f(0, 0);
+            glVertex2f(BOARD_W * CELL, 0);
+            glVertex2f(BOARD_W * CELL, BOARD_H * CELL);
+            glVertex2f(0, BOARD_H * CELL);
+            glEnd();
+
+            // Grid lines
+            glColor3f(0.15f, 0.15f, 0.15f);
+            for (int i = 0; i <= BOARD_W; i++) {
+                glBegin(GL_LINES);
+                glVertex2f(i * CELL, 0);
+                glVertex2f(i * CELL, BOARD_H * CELL);
+                glEnd();
+            }
+            for (int i = 0; i <= BOARD_H; i++) {
+                glBegin(GL_LINES);
+                glVertex2f(0, i * CELL);
+                glVertex2f(BOARD_W * CELL, i * CELL);
+                glEnd();
+            }
+
+            // Locked blocks, row by row straight from the occupancy masks
+            for (int y = 0; y < BOARD_H; y++) {
+                const uint8_t *colors = board->getColorRow(y);
+                for (RowMask mask = board->getRow(y); mask; mask &= (RowMask)(mask - 1)) {
+                    int x = __builtin_ctz(mask);
+                    drawBlockAt(Vec2((float)x, (float)y), colorAt(colors, x));
+                }
+            }
+
+            // Landing preview
+            int ghostDrop = board->dropDistance(*currentPiece);
+            for (const auto &cellPos : currentPiece->getWorldPositions()) {
+                Vec2 pos = cellPos + Vec2(0, (float)ghostDrop);
+                if (ghostDrop > 0 && pos.y >= 0)
+                    drawGhostAt(pos, currentPiece->colorIndex);
+            }
+
+            // Current piece, interpolated from its previous tick when it only slid
+            Vec2 offset = pieceOffset();
+            for (const auto &cellPos : currentPiece->getWorldPositions()) {
+                Vec2 pos = cellPos + offset;
+                if (pos.y >= 0 && pos.y < BOARD_H && pos.x >= (-0.01f)&& pos.x < BOARD_W)
+                    drawBlockAt(pos, currentPiece->colorIndex);
+            }
+        }
+
+        void drawSidePanel() const {
+            PROFILE_SCOPE(ZONE_DRAW_SIDE_PANEL);
+            float panelX = BOARD_W * CELL + PANEL_X_OFFSET;
+
+            // Static labels: "Next:" and the controls, one list for all
+            panelText.drawLabels([panelX] {
+                glColor3f(1, 1, 1);
+                drawBitmapText(panelX, PANEL_TOP, "Next:");
+                float y = CONTROLS_Y;
+                glColor3f(0.7f, 0.7f, 0.7f);
+                drawBitmapText(panelX, y, "Controls:");
+                drawBitmapText(panelX, y - 20, "Arrows: Move");
+                drawBitmapText(panelX, y - 40, "Up: Rotate");
+                drawBitmapText(panelX, y - 60, "Space: Drop");
+                drawBitmapText(panelX, y - 80, "R: Restart");
+                drawBitmapText(panelX, y - 100, "A: Autoplay");
+                drawBitmapText(panelX, y - 120, "U: Undo");
+            });
+            long calls = 1;
+
+            // Next piece section
+            float yPos = PREVIEW_Y;
+            for (const auto &localPos : nextPiece->state().cells) {
+                float x = panelX + 20 + (localPos.x + 1.5f) * PANEL_PREVIEW_SCALE;
+                float y = yPos - (localPos.y + 1.5f) * PANEL_PREVIEW_SCALE;
+
+                setGLColor(nextPiece->colorIndex);
+                glBegin(GL_QUADS);
+                glVertex2f(x, y);
+                glVertex2f(x + PANEL_PREVIEW_SCALE - 2, y);
+                glVertex2f(x + PANEL_PREVIEW_SCALE - 2, y + PANEL_PREVIEW_SCALE - 2);
+                glVertex2f(x, y + PANEL_PREVIEW_SCALE - 2);
+                glEnd();
+                calls++;
+            }
+
+            // Score section, re-rendered only when a number changes
+            yPos = SCORE_Y;
+            glColor3f(1, 1, 1);
+            panelText.drawField(0, panelX, yPos, "Score:", board->getScore());
+            panelText.drawField(1, panelX, yPos - 20, "High:", board->getHighScore());
+            panelText.drawField(2, panelX, yPos - 40, "Lines:", board->getLinesClearedTotal());
+            calls += 3;
+
+            // Overlay text changes all the time, so it is not cached
+            if (overlay[0]) {
+                glColor3f(1.0f, 0.85f, 0.3f);
+                char line[OVERLAY_SIZE];
+                const char *text = overlay;
+                for (float y = OVERLAY_Y; *text; y -= 16) {
+                    size_t n = strcspn(text, "\n");
+                    memcpy(line, text, n);
+                    line[n] = '\0';
+                    calls += drawBitmapText(panelX, y, line);
+                    text += n + (text[n] ? 1 : 0);
+                }
+            }
+            panelCalls += calls;
+            panelFrames++;
+
+            // Game over
+            if (board->isGameOver()) {
+                float t = glutGet(GLUT_ELAPSED_TIME) / 1000.0f;
+                glColor3f(1, 0, 0);
+                banner.draw(1.0f + 0.3f * sinf(t * 4.0f));
+            }
+        }
+
+        // Average GL calls per drawSidePanel (the banner aside)
+        double getPanelCallsPerFrame() const { return panelFrames ? (double)panelCalls / panelFrames : 0.0; }
+        long getPanelTextRebuilds() const { return panelText.getRebuilds(); }
+
+        // Updates the retained frame and blits it to the bound framebuffer.
+        // Each dirty rectangle redraws only the areas it overlaps, scissored;
+        // withPanel = false leaves the side panel out entirely. False when
+        // the context has no framebuffer objects and nothing was drawn.
+        bool renderRetained(bool withPanel) const {
+            markDirty(withPanel);
+            return frame.update([this, withPanel](const Rect &r) {
+                if (r.x0 <= BOARD_W * CELL)
+                    drawBoard();
+                if (withPanel && r.x1 > BOARD_W * CELL)
+                    drawSidePanel();
+            });
+        }
+
+        // Board pixels redrawn last frame and on average, against a full frame
+        long getRedrawnPixels() const { return frame.getRedrawnPixels(); }
+        double getRedrawnPixelsPerFrame() const { return frame.getRedrawnPixelsPerFrame(); }
+        long getFramePixels() const { return frame.getFramePixels(); }
+
+        void render() const {
+            if (!renderRetained(true)) {
+                glClear(GL_COLOR_BUFFER_BIT);
+                drawBoard();
+                drawSidePanel();
+            }
+            glutSwapBuffers();
+        }
+    };
+}
+
+#endif // TETRIS_HEADLESS
+
+#ifndef TETRIS_HEADLESS
+
+// ============================================================================
+// GLUT FRONT-END (Thin client of GameEngine::Game)
+// ============================================================================
+
+namespace Frontend {
+    using namespace GameEngine;
+    using namespace Renderer;
+
+    typedef chrono::steady_clock Clock;
+
+    inline double millisBetween(Clock::time_point a, Clock::time_point b) {
+        return chrono::duration<double, milli>(b - a).count();
+    }
+
+    // Frame pacing and latency counters, all in milliseconds
+    struct FrameStats {
+        double frameMs = 0, frameAvgMs = 0, frameMaxMs = 0;
+        double latencyMs = 0, latencyAvgMs = 0, latencyMaxMs = 0;
+        long frames = 0;
+        long ticks = 0;
+        long inputs = 0;
+
+        void addFrame(double ms) {
+            frameMs = ms;
+            frameAvgMs = frames ? frameAvgMs + (ms - frameAvgMs) * 0.05 : ms;
+            frameMaxMs = max(frameMaxMs, ms);
+            frames++;
+        }
+
+        void addLatency(double ms) {
+            latencyMs = ms;
+            latencyAvgMs = inputs ? latencyAvgMs + (ms - latencyAvgMs) * 0.1 : ms;
+            latencyMaxMs = max(latencyMaxMs, ms);
+            inputs++;
+        }
+    };
+
+    // Fixed-timestep driver: the simulation advances in whole ticks from an
+    // accumulator fed by glutIdleFunc, input is applied the moment it
+    // arrives, and frames are paced independently of both.
+    class GlutClient {
+    private:
+        Game game;
+        GameRenderer renderer;
+        Piece previousPiece;            // Piece before the last tick, for interpolation
+        int64_t tickUs;
+        int64_t frameIntervalUs;
+        int64_t accumulatorUs;
+        Clock::time_point lastUpdate;
+        Clock::time_point lastFrame;
+        Clock::time_point lastTitle;
+        Clock::time_point inputTime;
+        bool inputPending;
+        FrameStats stats;
+        Bot::AutoPlayer bot;
+        bool autoplay;                  // Bot feeds one input per tick instead of the keyboard
+        unique_ptr<Replay::Recorder> recorder;
+        int64_t tick;                   // Whole ticks simulated, the replay time base
+        StateHistory history;           // One state per piece, taken at its spawn
+        long historyPieces;             // getPiecesPlaced() of the newest history entry
+#ifdef TETRIS_PROFILE
+        bool profileOverlay;
+        Clock::time_point lastOverlay;
+
+        // Frame, simulation and draw time percentiles, twice a second
+        void updateOverlay(Clock::time_point now) {
+            if (!profileOverlay || millisBetween(lastOverlay, now) < 500.0) return;
+            lastOverlay = now;
+            Profiler::Percentiles frame = Profiler::framePercentiles(Profiler::ZONE_COUNT);
+            Profiler::Percentiles sim = Profiler::framePercentiles(Profiler::ZONE_GAME_STEP);
+            Profiler::Percentiles board = Profiler::framePercentiles(Profiler::ZONE_DRAW_BOARD);
+            Profiler::Percentiles panel = Profiler::framePercentiles(Profiler::ZONE_DRAW_SIDE_PANEL);
+            char text[160];
+            snprintf(text, sizeof(text), "ms p50 / p99 / max\nFrame %.2f %.2f %.2f\nSim %.2f %.2f %.2f\n"
+                     "Draw %.2f %.2f %.2f",
+                     frame.p50, frame.p99, frame.max, sim.p50, sim.p99, sim.max,
+                     board.p50 + panel.p50, board.p99 + panel.p99, board.max + panel.max);
+            renderer.setOverlay(text);
+        }
+#endif
+
+        void trackHistory(unsigned inputs) {
+            if (inputs & INPUT_RESTART)
+                history.clear();
+            if (history.size() == 0 || game.getPiecesPlaced() != historyPieces) {
+                history.push(game);
+                historyPieces = game.getPiecesPlaced();
+            }
+        }
+
+        void updateTitle(Clock::time_point now) {
+            if (millisBetween(lastTitle, now) < 1000.0) return;
+            lastTitle = now;
+            char title[128];
+            snprintf(title, sizeof(title), "Tetris - %.0f fps, frame %.2f ms, input %.2f ms%s",
+                     stats.frameAvgMs > 0 ? 1000.0 / stats.frameAvgMs : 0.0,
+                     stats.frameAvgMs, stats.latencyAvgMs, autoplay ? " [autoplay]" : "");
+            glutSetWindowTitle(title);
+        }
+
+    public:
+        GlutClient(uint64_t seed, Randomizer mode, int tickRate, int maxFps)
+            : game(seed, mode),
+              renderer(&game.getBoard(), &game.getCurrentPiece(), &game.getNextPiece()),
+              tickUs(1000000 / max(1, tickRate)),
+              frameIntervalUs(maxFps > 0 ? 1000000 / maxFps : 0),
+              accumulatorUs(0), inputPending(false), autoplay(false), tick(0),
+              history(UNDO_DEPTH), historyPieces(0) {
+#ifdef TETRIS_PROFILE
+            profileOverlay = false;
+#endif
+            previousPiece = game.getCurrentPiece();
+            trackHistory(INPUT_NONE);
+            lastUpdate = lastFrame = lastTitle = Clock::now();
+        }
+
+        void input(unsigned inputs) {
+            if (!inputPending) {
+                inputTime = Clock::now();
+                inputPending = true;
+            }
+            if (inputs & INPUT_RESTART)
+                bot.reset();
+            if (recorder)
+                recorder->record(tick, inputs);
+            game.step(inputs, 0);
+            trackHistory(inputs);
+            previousPiece = game.getCurrentPiece();
+            glutPostRedisplay();
+        }
+
+        // Back to the spawn of the previous piece. Not while recording: a
+        // replay is an input stream and has no way to express it.
+        void undo() {
+            if (recorder || history.size() < 2) return;
+            history.pop(game);
+            history.pop(game);
+            history.push(game);
+            historyPieces = game.getPiecesPlaced();
+            bot.reset();
+            previousPiece = game.getCurrentPiece();
+            glutPostRedisplay();
+        }
+
+        // Records everything from the current state on; the game restarts
+        // so the replay starts from its seed
+        bool startRecording(const char *path) {
+            game.reset(game.getSeed(), game.getRandomizer());
+            trackHistory(INPUT_RESTART);
+            previousPiece = game.getCurrentPiece();
+            tick = 0;
+            recorder.reset(new Replay::Recorder(path, game, (uint32_t)tickUs));
+            if (recorder->isOpen()) return true;
+            recorder.reset();
+            return false;
+        }
+
+        bool finishRecording() {
+            if (!recorder) return true;
+            bool ok = recorder->finish(tick, game);
+            recorder.reset();
+            return ok;
+        }
+
+        void toggleAutoplay() {
+            autoplay = !autoplay;
+            bot.reset();
+            lastTitle = Clock::time_point();
+        }
+
+        void idle() {
+            Clock::time_point now = Clock::now();
+            int64_t elapsedUs = chrono::duration_cast<chrono::microseconds>(now - lastUpdate).count();
+            lastUpdate = now;
+
+            // Clamp so a stall (window drag, debugger) cannot queue up a burst of ticks
+            accumulatorUs += min(elapsedUs, (int64_t)MAX_FRAME_STEP_MS * 1000);
+            while (accumulatorUs >= tickUs) {
+                previousPiece = game.getCurrentPiece();
+                unsigned inputs = INPUT_NONE;
+                if (autoplay) {
+                    // Soak testing: keep playing through top-outs
+                    if (game.isGameOver()) {
+                        inputs = INPUT_RESTART;
+                        bot.reset();
+                    } else {
+                        inputs = bot.nextInput(game);
+                    }
+                }
+                if (recorder)
+                    recorder->record(tick, inputs);
+                game.step(inputs, tickUs);
+                trackHistory(inputs);
+                accumulatorUs -= tickUs;
+                stats.ticks++;
+                tick++;
+            }
+
+            int64_t sinceFrameUs = chrono::duration_cast<chrono::microseconds>(now - lastFrame).count();
+            if (sinceFrameUs >= frameIntervalUs) {
+                glutPostRedisplay();
+            } else {
+                int64_t waitUs = min(frameIntervalUs - sinceFrameUs, tickUs - accumulatorUs);
+                this_thread::sleep_for(chrono::microseconds(min(waitUs, (int64_t)1000)));
+            }
+        }
+
+        void render() {
+            Clock::time_point start = Clock::now();
+            renderer.setInterpolation(previousPiece, (float)accumulatorUs / (float)tickUs);
+            renderer.render();
+
+            Clock::time_point now = Clock::now();
+            if (inputPending) {
+                // Wait for the frame to reach the display before stamping it
+                glFinish();
+                now = Clock::now();
+                stats.addLatency(millisBetween(inputTime, now));
+                inputPending = false;
+            }
+            stats.addFrame(millisBetween(lastFrame, now));
+            lastFrame = start;
+            updateTitle(now);
+#ifdef TETRIS_PROFILE
+            Profiler::endFrame();
+            updateOverlay(now);
+#endif
+        }
+
+#ifdef TETRIS_PROFILE
+        void toggleProfileOverlay() {
+            profileOverlay = !profileOverlay;
+            lastOverlay = Clock::time_point();
+            renderer.setOverlay(nullptr);
+            glutPostRedisplay();
+        }
+#endif
+
+        const FrameStats &getStats() const { return stats; }
+        const GameRenderer &getRenderer() const { return renderer; }
+    };
+
+    GlutClient *client = nullptr;
+}
+
+// ============================================================================
+// GLUT CALLBACKS
+// ============================================================================
+
+void display() {
+    if (Frontend::client)
+        Frontend::client->render();
+}
+
+void idleFunc() {
+    if (Frontend::client)
+        Frontend::client->idle();
+}
+
+void specialKey(int key, int x, int y) {
+    if (!Frontend::client) return;
+
+    switch (key) {
+    case GLUT_KEY_LEFT:
+        Frontend::client->input(GameEngine::INPUT_LEFT);
+        break;
+    case GLUT_KEY_RIGHT:
+        Frontend::client->input(GameEngine::INPUT_RIGHT);
+        break;
+    case GLUT_KEY_DOWN:
+        Frontend::client->input(GameEngine::INPUT_SOFT_DROP);
+        break;
+    case GLUT_KEY_UP:
+        Frontend::client->input(GameEngine::INPUT_ROTATE);
+        break;
+    }
+}
+
+// Closing the window exits without going through keyboard(); this still
+// writes the replay footer so the recording is not lost
+void finishRecordingAtExit() {
+    if (Frontend::client && !Frontend::client->finishRecording())
+        cerr << "error writing replay" << endl;
+}
+
+void keyboard(unsigned char key, int x, int y) {
+    if (!Frontend::client) return;
+
+    if (key == 27) {
+        const Frontend::FrameStats &stats = Frontend::client->getStats();
+        cout << stats.frames << " frames, avg " << stats.frameAvgMs << " ms, max " << stats.frameMaxMs
+             << " ms; input-to-photon avg " << stats.latencyAvgMs << " ms, max "
+             << stats.latencyMaxMs << " ms" << endl;
+        const Renderer::GameRenderer &renderer = Frontend::client->getRenderer();
+        cout << "side panel: " << renderer.getPanelCallsPerFrame() << " GL calls/frame, text lists compiled "
+             << renderer.getPanelTextRebuilds() << " times" << endl;
+        if (!Frontend::client->finishRecording())
+            cerr << "error writing replay" << endl;
+        exit(0);
+    }
+    if (key == ' ') Frontend::client->input(GameEngine::INPUT_HARD_DROP);
+    if (key == 'r' || key == 'R') Frontend::client->input(GameEngine::INPUT_RESTART);
+    if (key == 'u' || key == 'U') Frontend::client->undo();
+    if (key == 'a' || key == 'A') Frontend::client->toggleAutoplay();
+#ifdef TETRIS_PROFILE
+    if (key == 'p' || key == 'P') Frontend::client->toggleProfileOverlay();
+    if (key == 't' || key == 'T') {
+        const char *path = "tetris_trace.json";
+        if (Profiler::exportTrace(path))
+            cout << "trace written to " << path << endl;
+        else
+            cerr << "cannot write " << path << endl;
+    }
+#endif
+}
+
+void reshape(int w, int h) {
+    glViewport(0, 0, w, h);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0, w, 0, h);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+void initGL() {
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glShadeModel(GL_FLAT);
+}
+
+#ifdef TETRIS_RENDER_BENCH
+
+// ============================================================================
+// MAIN (Software-GL Render Benchmark)
+// ============================================================================
+
+// Renders the same deterministic game through the immediate-mode, the
+// batched and the retained (dirty-region) board paths on an offscreen EGL
+// context (Mesa llvmpipe when no GPU is present) and compares board frame
+// times. The retained path is also checked against a full redraw.
+namespace RenderBench {
+    using namespace GameEngine;
+
+    typedef chrono::steady_clock Clock;
+
+    bool createContext() {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        EGLDisplay display = getPlatformDisplay
+            ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+            : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+            return false;
+        if (!eglBindAPI(EGL_OPENGL_API))
+            return false;
+        EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, nullptr);
+        if (context == EGL_NO_CONTEXT)
+            return false;
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+            return false;
+
+        // A surfaceless context has no window: draw into our own framebuffer
+        GLExt::init(eglGetProcAddress);
+        if (!GLExt::hasFramebuffers)
+            return false;
+        GLuint fbo, color;
+        GLExt::genFramebuffers(1, &fbo);
+        GLExt::bindFramebuffer(GL_FRAMEBUFFER, fbo);
+        GLExt::genRenderbuffers(1, &color);
+        GLExt::bindRenderbuffer(GL_RENDERBUFFER, color);
+        GLExt::renderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, Config::WINDOW_W, Config::WINDOW_H);
+        GLExt::framebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        return GLExt::checkFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    enum Path { PATH_IMMEDIATE, PATH_BATCHED, PATH_RETAINED };
+
+    struct PathResult {
+        double avgMs;
+        double maxMs;
+        double drawCallsPerFrame;
+        double cellsPerFrame;
+        double pixelsPerFrame;
+        long mismatches;        // Retained frames that differed from a full redraw
+    };
+
+    // Every VERIFY_EVERY frames the retained path reads its output back and
+    // compares it with a from-scratch batched redraw (outside the timing)
+    const int VERIFY_EVERY = 16;
+
+    PathResult runPath(Path path, int frames, uint64_t seed) {
+        Game game(seed, Tetromino::RANDOMIZER_BAG7);
+        Renderer::GameRenderer renderer(&game.getBoard(), &game.getCurrentPiece(), &game.getNextPiece());
+        Random::Xoshiro128 rng(seed);
+        const int64_t tickUs = 1000000 / Config::DEFAULT_TICK_RATE;
+
+        const int framePixels = Config::WINDOW_W * Config::WINDOW_H;
+        vector<uint32_t> retained(framePixels), reference(framePixels);
+        double totalMs = 0, maxMs = 0;
+        long drawCalls = 0, cells = 0, pixels = 0, mismatches = 0;
+        for (int f = 0; f < frames; f++) {
+            unsigned input = rng.nextBelow(20) == 0 ? INPUT_HARD_DROP : (unsigned)INPUT_LEFT << rng.nextBelow(4);
+            game.step(input, tickUs);
+            if (game.isGameOver())
+                game.step(INPUT_RESTART, 0);
+            renderer.setInterpolation(game.getCurrentPiece(), 1.0f);
+
+            int locked = 0;
+            for (int y = 0; y < Config::BOARD_H; y++)
+                locked += __builtin_popcount(game.getBoard().getRow(y));
+            cells += locked;
+            // Immediate mode: background, one glBegin per grid line, fill + outline
+            // per block, one fill per ghost cell
+            if (path == PATH_IMMEDIATE)
+                drawCalls += 1 + (Config::BOARD_W + 1) + (Config::BOARD_H + 1) + 2 * (locked + 4) + 4;
+
+            Clock::time_point start = Clock::now();
+            if (path == PATH_RETAINED) {
+                renderer.renderRetained(false);
+            } else {
+                glClear(GL_COLOR_BUFFER_BIT);
+                if (path == PATH_BATCHED)
+                    renderer.drawBoard();
+                else
+                    renderer.drawBoardImmediate();
+            }
+            glFinish();
+            double ms = chrono::duration<double, milli>(Clock::now() - start).count();
+            totalMs += ms;
+            maxMs = max(maxMs, ms);
+
+            if (path == PATH_RETAINED) {
+                pixels += renderer.getRedrawnPixels();
+                if (f % VERIFY_EVERY == 0) {
+                    glReadPixels(0, 0, Config::WINDOW_W, Config::WINDOW_H, GL_RGBA, GL_UNSIGNED_BYTE, retained.data());
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    renderer.drawBoard();
+                    glReadPixels(0, 0, Config::WINDOW_W, Config::WINDOW_H, GL_RGBA, GL_UNSIGNED_BYTE, reference.data());
+                    if (retained != reference)
+                        mismatches++;
+                }
+            } else {
+                pixels += framePixels;
+                if (path == PATH_BATCHED)
+                    drawCalls += 2;
+            }
+        }
+        return PathResult{totalMs / frames, maxMs, (double)drawCalls / frames, (double)cells / frames,
+                          (double)pixels / frames, mismatches};
+    }
+}
+
+// Usage: tetris_render_bench [frames] [seed]
+int main(int argc, char **argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 2000;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : 1;
+    if (frames <= 0) frames = 1;
+
+    if (!RenderBench::createContext()) {
+        cerr << "render bench: could not create an offscreen EGL/OpenGL context with framebuffer objects" << endl;
+        return 1;
+    }
+    cout << "Renderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << endl;
+    if (!GLExt::hasBuffers) {
+        cerr << "render bench: the batched path needs GL buffer objects" << endl;
+        return 1;
+    }
+
+    initGL();
+    reshape(Config::WINDOW_W, Config::WINDOW_H);
+
+    RenderBench::PathResult immediate = RenderBench::runPath(RenderBench::PATH_IMMEDIATE, frames, seed);
+    RenderBench::PathResult batched = RenderBench::runPath(RenderBench::PATH_BATCHED, frames, seed);
+    RenderBench::PathResult retained = RenderBench::runPath(RenderBench::PATH_RETAINED, frames, seed);
+
+    cout << frames << " frames, " << immediate.cellsPerFrame << " locked cells/frame on average" << endl;
+    cout << "immediate: " << immediate.avgMs << " ms/frame (max " << immediate.maxMs << "), "
+         << immediate.drawCallsPerFrame << " draw calls/frame" << endl;
+    cout << "batched:   " << batched.avgMs << " ms/frame (max " << batched.maxMs << "), "
+         << batched.drawCallsPerFrame << " draw calls/frame" << endl;
+    cout << "retained:  " << retained.avgMs << " ms/frame (max " << retained.maxMs << "), "
+         << retained.pixelsPerFrame << " of " << Config::WINDOW_W * Config::WINDOW_H
+         << " pixels redrawn/frame" << endl;
+    cout << "speedup x" << immediate.avgMs / batched.avgMs << " batched, x"
+         << immediate.avgMs / retained.avgMs << " retained" << endl;
+    if (retained.mismatches) {
+        cerr << "render bench: " << retained.mismatches << " retained frames differ from a full redraw" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+#else // TETRIS_RENDER_BENCH
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+// Usage: tetris [seed] [uniform|bag] [tickRate] [maxFps] [replayFile]
+int main(int argc, char **argv) {
+    glutInit(&argc, argv);
+
+    uint64_t seed = argc > 1 ? strtoull(argv[1], nullptr, 10) : (uint64_t)time(nullptr);
+    Tetromino::Randomizer mode = Tetromino::parseRandomizer(argc > 2 ? argv[2] : "uniform");
+    int tickRate = argc > 3 ? atoi(argv[3]) : Config::DEFAULT_TICK_RATE;
+    int maxFps = argc > 4 ? atoi(argv[4]) : Config::DEFAULT_MAX_FPS;
+    cout << "Seed: " << seed << " (" << Tetromino::randomizerName(mode) << ")" << endl;
+    Frontend::client = new Frontend::GlutClient(seed, mode, tickRate, maxFps);
+    if (argc > 5 && !Frontend::client->startRecording(argv[5])) {
+        cerr << "cannot write replay " << argv[5] << endl;
+        return 1;
+    }
+    atexit(finishRecordingAtExit);
+
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
+    glutInitWindowSize(Config::WINDOW_W, Config::WINDOW_H);
+    glutInitWindowPosition(100, 100);
+    glutCreateWindow("Tetris - Pure Matrix Transform (No Grid)");
+
+#ifdef FREEGLUT
+    GLExt::init(glutGetProcAddress);
+#else
+    GLExt::init(GLExt::noProcAddress);
+#endif
+    if (!GLExt::hasBuffers)
+        cerr << "GL buffer objects unavailable, drawing in immediate mode" << endl;
+    if (!GLExt::hasFramebuffers)
+        cerr << "GL framebuffer objects unavailable, redrawing every frame in full" << endl;
+    initGL();
+
+    glutDisplayFunc(display);
+    glutReshapeFunc(reshape);
+    glutKeyboardFunc(keyboard);
+    glutSpecialFunc(specialKey);
+    glutIdleFunc(idleFunc);
+
+    glutMainLoop();
+
+    finishRecordingAtExit();
+    delete Frontend::client;
+    Frontend::client = nullptr;
+    return 0;
+}
+
+#endif // TETRIS_RENDER_BENCH
+
+#else // TETRIS_HEADLESS
+
+#ifdef TETRIS_ALLOC_CHECK
+
+// ============================================================================
+// ALLOCATION COUNTER (Headless, -DTETRIS_ALLOC_CHECK)
+// ============================================================================
+
+// Every heap allocation in the check binary goes through here so the
+// alloccheck command can prove the gameplay hot path never allocates.
+// Other builds keep the default allocator.
+namespace AllocCounter {
+    atomic<long> allocations(0);
+
+    long count() { return allocations.load(memory_order_relaxed); }
+}
+
+// noinline keeps GCC from pairing the inlined malloc/free with new/delete
+__attribute__((noinline)) void *operator new(size_t size) {
+    AllocCounter::allocations.fetch_add(1, memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+#endif // TETRIS_ALLOC_CHECK
+
+#ifdef TETRIS_TUNER
+
+// ============================================================================
+// MAIN (Evolutionary Weight Tuner)
+// ============================================================================
+
+// Evolves Bot::Weights by playing seeded games with every candidate on all
+// cores. Each generation every candidate plays the same games (common
+// seeds), the better half survives and the rest is refilled with
+// fitness-weighted crossovers plus mutation. The population is written to
+// a checkpoint after every generation and picked up again on restart.
+namespace Tuner {
+    using namespace GameEngine;
+
+    typedef chrono::steady_clock Clock;
+
+    const int GENES = 7;
+    typedef array<float, GENES> Genome;         // Bot::Weights in field order
+
+    Bot::Weights toWeights(const Genome &g) {
+        Bot::Weights w;
+        w.holes = g[0];
+        w.bumpiness = g[1];
+        w.aggregateHeight = g[2];
+        w.lines = g[3];
+        w.rowTransitions = g[4];
+        w.columnTransitions = g[5];
+        w.wells = g[6];
+        return w;
+    }
+
+    // Only the direction of the weight vector matters to the bot
+    void normalize(Genome &g) {
+        float length = 0;
+        for (float v : g)
+            length += v * v;
+        length = sqrtf(length);
+        if (length <= 0) return;
+        for (float &v : g)
+            v /= length;
+    }
+
+    float uniform(Random::Xoshiro128 &rng, float lo, float hi) {
+        return lo + (hi - lo) * (float)(rng.next() >> 8) * (1.0f / (1 << 24));
+    }
+
+    struct Individual {
+        Genome genes;
+        double fitness = 0;             // Lines per game in the last evaluation
+    };
+
+    struct Settings {
+        int generations = 50;
+        int population = 32;
+        int games = 8;                  // Games per candidate per generation
+        long maxPieces = 500;
+        int beamWidth = 1;
+        int threads = 0;                // 0 = one per core
+        uint64_t seed = 1;
+        string checkpoint = "tuner.pop";
+    };
+
+    struct State {
+        int generation = 0;
+        uint64_t seed = 0;
+        Random::Xoshiro128 rng;
+        vector<Individual> population;
+    };
+
+    // Text format, one candidate per line, floats written to round-trip.
+    // Written to a temporary file and renamed so a crash never leaves a
+    // half-written checkpoint behind.
+    bool saveCheckpoint(const string &path, const State &state) {
+        string tmp = path + ".tmp";
+        FILE *f = fopen(tmp.c_str(), "w");
+        if (!f) return false;
+        fprintf(f, "tetris-tuner 1\n");
+        fprintf(f, "generation %d\n", state.generation);
+        fprintf(f, "seed %llu\n", (unsigned long long)state.seed);
+        fprintf(f, "rng %u %u %u %u\n", state.rng.s[0], state.rng.s[1], state.rng.s[2], state.rng.s[3]);
+        fprintf(f, "population %d %d\n", (int)state.population.size(), GENES);
+        for (const Individual &ind : state.population) {
+            for (float g : ind.genes)
+                fprintf(f, "%.9g ", g);
+            fprintf(f, "%.9g\n", ind.fitness);
+        }
+        bool ok = fflush(f) == 0;
+        ok = fclose(f) == 0 && ok;
+        return ok && rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    bool loadCheckpoint(const string &path, State &state) {
+        FILE *f = fopen(path.c_str(), "r");
+        if (!f) return false;
+        int version = 0, count = 0, genes = 0;
+        unsigned long long seed = 0;
+        bool ok = fscanf(f, "tetris-tuner %d generation %d seed %llu rng %u %u %u %u population %d %d",
+                         &version, &state.generation, &seed, &state.rng.s[0], &state.rng.s[1],
+                         &state.rng.s[2], &state.rng.s[3], &count, &genes) == 9 &&
+                  version == 1 && genes == GENES && count > 0;
+        state.seed = seed;
+        state.population.assign(ok ? count : 0, Individual());
+        for (int i = 0; ok && i < count; i++) {
+            for (int g = 0; ok && g < GENES; g++)
+                ok = fscanf(f, "%f", &state.population[i].genes[g]) == 1;
+            ok = ok && fscanf(f, "%lf", &state.population[i].fitness) == 1;
+        }
+        fclose(f);
+        return ok;
+    }
+
+    // Plays every (candidate, game) pair of a generation on the pool. Each
+    // worker keeps one Game and one Planner and only swaps the weights.
+    class Evaluator {
+    private:
+        struct alignas(64) WorkerState {
+            Game game;
+            Bot::Planner planner;
+            unsigned path[Bot::Planner::MAX_PATH];
+
+            explicit WorkerState(const Bot::BotConfig &config) : planner(config) {}
+        };
+
+        Parallel::WorkStealingPool pool;
+        vector<unique_ptr<WorkerState>> workers;
+        Bot::BotConfig config;
+        vector<long> lines, pieces;
+
+    public:
+        Evaluator(int threads, int beamWidth) : pool(threads), workers(pool.size()) {
+            config.beamWidth = beamWidth;
+            config.budgetUs = 60 * 1000000LL;   // Never cut a search short: results must not depend on timing
+            config.tableBits = 0;
+        }
+
+        // Sets every fitness to lines per game; returns the pieces played
+        long evaluate(vector<Individual> &population, int games, long maxPieces, uint64_t seed) {
+            long total = (long)population.size() * games;
+            lines.assign(total, 0);
+            pieces.assign(total, 0);
+
+            pool.parallelFor(total, 1, [&](int w, long begin, long end) {
+                if (!workers[w])
+                    workers[w].reset(new WorkerState(config));
+                WorkerState &state = *workers[w];
+                for (long i = begin; i < end; i++) {
+                    state.planner.setWeights(toWeights(population[i / games].genes));
+                    state.game.reset(seed + (uint64_t)(i % games), Tetromino::RANDOMIZER_BAG7);
+                    while (!state.game.isGameOver() && state.game.getPiecesPlaced() < maxPieces) {
+                        int n = state.planner.plan(state.game, state.path);
+                        if (n <= 0) break;
+                        for (int j = 0; j < n; j++)
+                            state.game.step(state.path[j], 0);
+                    }
+                    lines[i] = state.game.getBoard().getLinesClearedTotal();
+                    pieces[i] = state.game.getPiecesPlaced();
+                }
+            });
+
+            long played = 0;
+            for (size_t c = 0; c < population.size(); c++) {
+                long sum = 0;
+                for (int g = 0; g < games; g++) {
+                    sum += lines[c * games + g];
+                    played += pieces[c * games + g];
+                }
+                population[c].fitness = (double)sum / games;
+            }
+            return played;
+        }
+
+        int threadCount() const { return pool.size(); }
+    };
+
+    Genome randomGenome(Random::Xoshiro128 &rng) {
+        Genome g;
+        for (float &v : g)
+            v = uniform(rng, -1.0f, 1.0f);
+        normalize(g);
+        return g;
+    }
+
+    const Individual &tournament(const vector<Individual> &population, Random::Xoshiro128 &rng) {
+        const Individual *best = nullptr;
+        for (int i = 0; i < 3; i++) {
+            const Individual &c = population[rng.nextBelow((uint32_t)population.size())];
+            if (!best || c.fitness > best->fitness)
+                best = &c;
+        }
+        return *best;
+    }
+
+    // Keeps the better half, refills the rest from tournament-picked parents
+    void breed(State &state) {
+        vector<Individual> &pop = state.population;
+        sort(pop.begin(), pop.end(), [](const Individual &a, const Individual &b) { return a.fitness > b.fitness; });
+        size_t keep = max<size_t>(1, pop.size() / 2);
+        vector<Individual> next(pop.begin(), pop.begin() + keep);
+        while (next.size() < pop.size()) {
+            const Individual &a = tournament(pop, state.rng);
+            const Individual &b = tournament(pop, state.rng);
+            double wa = a.fitness + 1e-3, wb = b.fitness + 1e-3;
+            Individual child;
+            for (int g = 0; g < GENES; g++)
+                child.genes[g] = (float)((a.genes[g] * wa + b.genes[g] * wb) / (wa + wb));
+            if (state.rng.nextBelow(4) == 0)
+                child.genes[state.rng.nextBelow(GENES)] += uniform(state.rng, -0.2f, 0.2f);
+            normalize(child.genes);
+            next.push_back(child);
+        }
+        pop.swap(next);
+    }
+}
+
+// Usage: tetris_tuner [generations] [population] [games] [maxPieces] [checkpoint] [seed] [threads] [beam]
+int main(int argc, char **argv) {
+    Tuner::Settings settings;
+    if (argc > 1) settings.generations = atoi(argv[1]);
+    if (argc > 2) settings.population = max(2, atoi(argv[2]));
+    if (argc > 3) settings.games = max(1, atoi(argv[3]));
+    if (argc > 4) settings.maxPieces = max(1L, atol(argv[4]));
+    if (argc > 5) settings.checkpoint = argv[5];
+    settings.seed = argc > 6 ? strtoull(argv[6], nullptr, 10) : (uint64_t)time(nullptr);
+    if (argc > 7) settings.threads = atoi(argv[7]);
+    if (argc > 8) settings.beamWidth = max(1, atoi(argv[8]));
+
+    Tuner::State state;
+    if (Tuner::loadCheckpoint(settings.checkpoint, state)) {
+        cout << "resuming " << settings.checkpoint << " at generation " << state.generation
+             << " (" << state.population.size() << " candidates, seed " << state.seed << ")" << endl;
+    } else {
+        state.seed = settings.seed;
+        state.rng.reseed(settings.seed);
+        state.population.resize(settings.population);
+        for (Tuner::Individual &ind : state.population)
+            ind.genes = Tuner::randomGenome(state.rng);
+        cout << "new population of " << settings.population << " in " << settings.checkpoint
+             << " (seed " << state.seed << ")" << endl;
+    }
+
+    Tuner::Evaluator evaluator(settings.threads, settings.beamWidth);
+    cout << evaluator.threadCount() << " threads, " << settings.games << " games of up to "
+         << settings.maxPieces << " pieces per candidate, beam " << settings.beamWidth << endl;
+
+    while (state.generation < settings.generations) {
+        uint64_t mix = state.seed ^ ((uint64_t)state.generation << 32);
+        uint64_t gameSeed = Random::splitMix64(mix);
+
+        Tuner::Clock::time_point start = Tuner::Clock::now();
+        long pieces = evaluator.evaluate(state.population, settings.games, settings.maxPieces, gameSeed);
+        double seconds = max(1e-9, chrono::duration<double>(Tuner::Clock::now() - start).count());
+
+        const Tuner::Individual *best = &state.population[0];
+        double mean = 0;
+        for (const Tuner::Individual &ind : state.population) {
+            mean += ind.fitness;
+            if (ind.fitness > best->fitness)
+                best = &ind;
+        }
+        mean /= state.population.size();
+
+        char line[256];
+        snprintf(line, sizeof(line), "gen %3d: best %.1f lines/game, mean %.1f, %.0f pieces/s, weights",
+                 state.generation, best->fitness, mean, pieces / seconds);
+        cout << line;
+        for (float g : best->genes)
+            cout << " " << g;
+        cout << endl;
+
+        Tuner::breed(state);
+        state.generation++;
+        if (!Tuner::saveCheckpoint(settings.checkpoint, state)) {
+            cerr << "tuner: could not write " << settings.checkpoint << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#else // TETRIS_TUNER
+
+// ============================================================================
+// MAIN (Headless)
+// ============================================================================
+
+namespace Headless {
+    using namespace GameEngine;
+
+    typedef chrono::steady_clock Clock;
+
+    double secondsSince(Clock::time_point start) {
+        double seconds = chrono::duration<double>(Clock::now() - start).count();
+        return seconds > 0 ? seconds : 1e-9;
+    }
+
+    // sim [games] [maxPieces] [seed] [uniform|bag]: independent Game
+    // objects fed random inputs at 60 simulated ticks per second. A fixed
+    // seed reproduces the run exactly.
+    int runGames(int argc, char **argv) {
+        int games = argc > 0 ? atoi(argv[0]) : 1000;
+        long maxPieces = argc > 1 ? atol(argv[1]) : 500;
+        uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : (uint64_t)time(nullptr);
+        Tetromino::Randomizer mode = Tetromino::parseRandomizer(argc > 3 ? argv[3] : "uniform");
+        const int64_t tickUs = 1000000 / 60;
+        const unsigned moves[] = {INPUT_NONE, INPUT_LEFT, INPUT_RIGHT, INPUT_ROTATE,
+                                  INPUT_SOFT_DROP, INPUT_HARD_DROP};
+
+        Random::Xoshiro128 rng(seed);
+
+        long totalPieces = 0;
+        long totalLines = 0;
+        long long totalScore = 0;
+        Clock::time_point start = Clock::now();
+        for (int g = 0; g < games; g++) {
+            Game game(seed + g, mode);
+            while (!game.isGameOver() && game.getPiecesPlaced() < maxPieces)
+                game.step(moves[rng.nextBelow(6)], tickUs);
+            totalPieces += game.getPiecesPlaced();
+            totalLines += game.getBoard().getLinesClearedTotal();
+            totalScore += game.getBoard().getScore();
+        }
+        double seconds = secondsSince(start);
+
+        cout << "seed " << seed << " (" << Tetromino::randomizerName(mode) << "), score " << totalScore << endl;
+        cout << games << " games, " << totalPieces << " pieces, " << totalLines << " lines in "
+             << seconds << " s (" << games / seconds << " games/s, "
+             << totalPieces / seconds << " pieces/s)" << endl;
+        return 0;
+    }
+
+    // batch [boards] [steps] [seed]: one BoardBatch stepped in lockstep with
+    // random actions; finished boards are reset in place.
+    int runBatch(int argc, char **argv) {
+        int boards = argc > 0 ? atoi(argv[0]) : 4096;
+        int steps = argc > 1 ? atoi(argv[1]) : 2000;
+        uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : (uint64_t)time(nullptr);
+        if (boards <= 0 || steps <= 0) {
+            cerr << "batch: boards and steps must be positive" << endl;
+            return 1;
+        }
+        cout << "seed " << seed << endl;
+
+        Simulation::BoardBatch batch(boards, seed);
+        vector<uint8_t> actions(boards);
+        Random::Xoshiro128 rng(seed ^ 0x5bd1e995u);
+
+        long games = 0;
+        long pieces = 0;
+        Clock::time_point start = Clock::now();
+        for (int s = 0; s < steps; s++) {
+            for (int b = 0; b < boards; b++)
+                actions[b] = (uint8_t)rng.nextBelow(Simulation::ACTION_HARD_DROP + 1);
+            batch.stepAll(actions.data());
+            for (int b = 0; b < boards; b++) {
+                if (batch.isGameOver(b)) {
+                    games++;
+                    pieces += batch.getPiecesPlaced(b);
+                    batch.reset(b);
+                }
+            }
+        }
+        double seconds = secondsSince(start);
+        for (int b = 0; b < boards; b++)
+            pieces += batch.getPiecesPlaced(b);
+
+        cout << boards << " boards x " << steps << " steps in " << seconds << " s ("
+             << (double)boards * steps / seconds << " board-steps/s, "
+             << pieces / seconds << " pieces/s, " << games << " games finished)" << endl;
+        return 0;
+    }
+
+    // selfplay [games] [maxThreads] [maxPieces] [seed]: random-placement
+    // games on the work-stealing runner at 1, 2, 4, ... threads.
+    int runSelfPlay(int argc, char **argv) {
+        long games = argc > 0 ? atol(argv[0]) : 200000;
+        int maxThreads = argc > 1 ? atoi(argv[1]) : (int)max(1u, thread::hardware_concurrency());
+        long maxPieces = argc > 2 ? atol(argv[2]) : 1000;
+        uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 10) : (uint64_t)time(nullptr);
+
+        double baseRate = 0;
+        for (int threads = 1; ; threads *= 2) {
+            if (threads > maxThreads) threads = maxThreads;
+
+            SelfPlay::SelfPlayRunner runner(threads);
+            Clock::time_point start = Clock::now();
+            SelfPlay::Totals totals = runner.run(games, maxPieces, seed);
+            double seconds = secondsSince(start);
+
+            double rate = totals.games / seconds;
+            if (threads == 1) baseRate = rate;
+            cout << threads << " threads: " << totals.games << " games, " << totals.pieces
+                 << " pieces in " << seconds << " s (" << rate << " games/s, "
+                 << totals.pieces / seconds << " pieces/s, speedup x"
+                 << (baseRate > 0 ? rate / baseRate : 1.0) << ")" << endl;
+            if (threads == maxThreads) break;
+        }
+        return 0;
+    }
+
+    // queue [count] [seed] [uniform|bag]: bulk piece generation rate and
+    // the resulting type histogram.
+    int runQueue(int argc, char **argv) {
+        long count = argc > 0 ? atol(argv[0]) : 10000000;
+        uint64_t seed = argc > 1 ? strtoull(argv[1], nullptr, 10) : (uint64_t)time(nullptr);
+        Tetromino::Randomizer mode = Tetromino::parseRandomizer(argc > 2 ? argv[2] : "uniform");
+        if (count <= 0) {
+            cerr << "queue: count must be positive" << endl;
+            return 1;
+        }
+
+        Tetromino::PieceFactory factory(seed, mode);
+        vector<uint8_t> queue(count);
+        Clock::time_point start = Clock::now();
+        factory.generateQueue(queue.data(), queue.size());
+        double seconds = secondsSince(start);
+
+        long histogram[Tetromino::PIECE_COUNT] = {};
+        for (uint8_t t : queue)
+            histogram[t]++;
+
+        const char names[] = "IOTSZJL";
+        cout << "seed " << seed << " (" << Tetromino::randomizerName(mode) << "), first pieces: ";
+        for (long i = 0; i < min(count, 14L); i++)
+            cout << names[queue[i]];
+        cout << endl << count << " pieces in " << seconds << " s (" << count / seconds << " pieces/s)" << endl;
+        for (int t = 0; t < Tetromino::PIECE_COUNT; t++)
+            cout << "  " << names[t] << ": " << histogram[t] << endl;
+        return 0;
+    }
+
+    // Drops the current piece where its top cell ends up lowest. Crude, but
+    // it keeps boards low and clears lines regularly. Works on a game of
+    // any board size.
+    template <class G>
+    void playLowestPlacement(G &game) {
+        const typename G::BoardType &board = game.getBoard();
+        Piece best = game.getCurrentPiece();
+        int bestDepth = -1000;
+        for (int rot = 0; rot < ROTATIONS; rot++) {
+            for (int x = 0; x < G::BoardType::WIDTH; x++) {
+                Piece p = game.getCurrentPiece();
+                p.rotation = rot;
+                p.x = x;
+                if (!board.canPlace(p)) continue;
+                while (true) {
+                    p.translate(0, 1);
+                    if (!board.canPlace(p)) break;
+                }
+                int depth = p.y - 1 + p.state().minY;
+                if (depth > bestDepth) {
+                    bestDepth = depth;
+                    best = p;
+                    best.y = game.getCurrentPiece().y;
+                }
+            }
+        }
+
+        while (game.getCurrentPiece().rotation != best.rotation && game.tryRotate()) {}
+        while (game.getCurrentPiece().x < best.x && game.tryMove(1, 0)) {}
+        while (game.getCurrentPiece().x > best.x && game.tryMove(-1, 0)) {}
+        game.hardDrop();
+    }
+
+    // alloccheck [pieces] [seed]: warms up, then drives Game through moves,
+    // rotations, soft/hard drops, locks, line clears, spawns, restarts and
+    // undo (plus a BoardBatch and the autoplay bot) and fails if any of it
+    // allocated. Needs -DTETRIS_ALLOC_CHECK.
+    int runAllocCheck(int argc, char **argv) {
+#ifndef TETRIS_ALLOC_CHECK
+        (void)argc;
+        (void)argv;
+        cerr << "alloccheck: built without -DTETRIS_ALLOC_CHECK" << endl;
+        return 1;
+#else
+        long pieces = argc > 0 ? atol(argv[0]) : 100000;
+        uint64_t seed = argc > 1 ? strtoull(argv[1], nullptr, 10) : (uint64_t)time(nullptr);
+        const int64_t tickUs = 1000000 / 60;
+        const int batchSize = 256;
+
+        Game game(seed, Tetromino::RANDOMIZER_BAG7);
+        Random::Xoshiro128 rng(seed);
+        Simulation::BoardBatch batch(batchSize, seed);
+        unique_ptr<Bot::AutoPlayer> bot(new Bot::AutoPlayer());
+        StateHistory history(8);
+        uint8_t actions[batchSize];
+        long lines = 0;
+        long restarts = 0;
+
+        auto play = [&](long count) {
+            for (long i = 0; i < count; i++) {
+                history.push(game);
+                int before = game.getBoard().getLinesClearedTotal();
+                for (int s = 0; s < 4; s++) {
+                    unsigned input = (unsigned)INPUT_LEFT << rng.nextBelow(4);
+                    game.step(input, tickUs);
+                }
+                if (i % 3 == 0) {
+                    SelfPlay::playRandomPlacement(game, rng);
+                } else if (i % 3 == 1) {
+                    playLowestPlacement(game);
+                } else {
+                    long placed = game.getPiecesPlaced();
+                    while (!game.isGameOver() && game.getPiecesPlaced() == placed)
+                        game.step(bot->nextInput(game), 0);
+                }
+                lines += max(0, game.getBoard().getLinesClearedTotal() - before);
+                if (i % 10 == 9)
+                    history.pop(game);
+
+                if (game.isGameOver()) {
+                    game.step(INPUT_RESTART, 0);
+                    bot->reset();
+                    restarts++;
+                }
+
+                for (int b = 0; b < batchSize; b++)
+                    actions[b] = (uint8_t)rng.nextBelow(Simulation::ACTION_HARD_DROP + 1);
+                batch.stepAll(actions);
+                for (int b = 0; b < batchSize; b++) {
+                    if (batch.isGameOver(b))
+                        batch.reset(b);
+                }
+            }
+        };
+
+        play(1000);
+        lines = 0;
+        restarts = 0;
+
+        long before = AllocCounter::count();
+        Clock::time_point start = Clock::now();
+        play(pieces);
+        double seconds = secondsSince(start);
+        long allocated = AllocCounter::count() - before;
+
+        cout << pieces << " placements, " << lines << " lines, " << restarts << " restarts in "
+             << seconds << " s: " << allocated << " heap allocations after warm-up" << endl;
+        if (allocated != 0) {
+            cerr << "alloccheck: FAILED, gameplay hot path allocated" << endl;
+            return 1;
+        }
+        cout << "alloccheck: OK" << endl;
+        return 0;
+#endif
+    }
+
+    int verifyReplays(const vector<string> &paths, int rounds) {
+        Game game;
+        long verified = 0, failed = 0, events = 0, pieces = 0;
+        double gameSeconds = 0;     // Each replay at the tick length in its header
+        size_t bytes = 0;
+        Clock::time_point start = Clock::now();
+        for (int r = 0; r < rounds; r++) {
+            for (const string &path : paths) {
+                Replay::MappedReplay replay;
+                if (!replay.open(path.c_str())) {
+                    cerr << "replay: cannot read " << path << endl;
+                    failed++;
+                    continue;
+                }
+                Replay::VerifyResult result = Replay::resimulate(replay, game);
+                if (!result.ok) {
+                    if (r == 0)
+                        cerr << "replay: MISMATCH in " << path << ": expected score " << result.expected.score
+                             << " lines " << result.expected.lines << " pieces " << result.expected.pieces
+                             << ", got " << result.actual.score << " / " << result.actual.lines << " / "
+                             << result.actual.pieces << endl;
+                    failed++;
+                    continue;
+                }
+                verified++;
+                events += result.events;
+                pieces += result.actual.pieces;
+                gameSeconds += (double)result.ticks * replay.getHeader().tickUs / 1e6;
+                bytes += replay.getSize();
+            }
+        }
+        double seconds = secondsSince(start);
+
+        if (verified) {
+            cout << verified << " replays verified in " << seconds << " s: " << verified / seconds
+                 << " replays/s, " << (double)pieces / verified << " pieces, "
+                 << (double)events / verified << " events and "
+                 << (double)bytes / verified << " bytes per replay ("
+                 << (double)(bytes - verified * (Replay::HEADER_SIZE + Replay::FOOTER_SIZE)) / max(1L, events)
+                 << " bytes/event)" << endl;
+            cout << "re-simulated " << gameSeconds / seconds << "x faster than real time" << endl;
+        }
+        if (failed) {
+            cerr << "replay: FAILED, " << failed << " replays did not verify" << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // replay [games] [maxPieces] [dir] [seed] [rounds]: records bot games
+    // at 60 ticks per second (with some random key presses mixed in) into
+    // dir, then maps and re-simulates them all.
+    // replay verify <files...>: re-simulates existing replays.
+    int runReplay(int argc, char **argv) {
+        if (argc > 0 && string(argv[0]) == "verify") {
+            vector<string> paths(argv + 1, argv + argc);
+            if (paths.empty()) {
+                cerr << "replay verify: no files given" << endl;
+                return 1;
+            }
+            return verifyReplays(paths, 1);
+        }
+
+        int games = argc > 0 ? atoi(argv[0]) : 20;
+        long maxPieces = argc > 1 ? atol(argv[1]) : 300;
+        string dir = argc > 2 ? argv[2] : "replays";
+        uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 10) : (uint64_t)time(nullptr);
+        int rounds = argc > 4 ? max(1, atoi(argv[4])) : 10;
+        const int64_t tickUs = 1000000 / Config::DEFAULT_TICK_RATE;
+        mkdir(dir.c_str(), 0755);
+
+        Game game;
+        Bot::AutoPlayer bot;
+        Random::Xoshiro128 rng(seed);
+        vector<string> paths;
+        double maxRecordUs = 0;
+        Clock::time_point start = Clock::now();
+        for (int g = 0; g < games; g++) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/game_%04d.trp", dir.c_str(), g);
+            game.reset(seed + (uint64_t)g, Tetromino::RANDOMIZER_BAG7);
+            bot.reset();
+            Replay::Recorder recorder(path, game, (uint32_t)tickUs);
+            if (!recorder.isOpen()) {
+                cerr << "replay: cannot write " << path << endl;
+                return 1;
+            }
+
+            int64_t tick = 0;
+            while (!game.isGameOver() && game.getPiecesPlaced() < maxPieces) {
+                unsigned inputs = tick % 2 == 0 ? bot.nextInput(game) : INPUT_NONE;
+                if (rng.nextBelow(120) == 0)
+                    inputs |= (unsigned)INPUT_LEFT << rng.nextBelow(3);
+                if (inputs) {
+                    Clock::time_point before = Clock::now();
+                    recorder.record(tick, inputs);
+                    maxRecordUs = max(maxRecordUs, chrono::duration<double, micro>(Clock::now() - before).count());
+                    game.step(inputs, 0);
+                }
+                game.step(INPUT_NONE, tickUs);
+                tick++;
+            }
+            if (!recorder.finish(tick, game)) {
+                cerr << "replay: error writing " << path << endl;
+                return 1;
+            }
+            paths.push_back(path);
+        }
+        cout << games << " games recorded to " << dir << "/ in " << secondsSince(start)
+             << " s, slowest record() " << maxRecordUs << " us" << endl;
+
+        return verifyReplays(paths, rounds);
+    }
+
+    // render <replay> <outDir|-> [ticksPerFrame]: draws a recorded game on
+    // the CPU, one frame every ticksPerFrame ticks, as outDir/frame_NNNNNN.png
+    // or, with "-", as raw rgb24 frames on stdout for an encoder:
+    //   tetris_headless render game.trp - |
+    //       ffmpeg -f rawvideo -pix_fmt rgb24 -s 384x480 -r 60 -i - clip.mp4
+    int runRender(int argc, char **argv) {
+        if (argc < 2) {
+            cerr << "usage: render <replay> <outDir|-> [ticksPerFrame]" << endl;
+            return 1;
+        }
+        Replay::MappedReplay replay;
+        if (!replay.open(argv[0])) {
+            cerr << "render: cannot read replay " << argv[0] << endl;
+            return 1;
+        }
+        string out = argv[1];
+        int every = argc > 2 ? max(1, atoi(argv[2])) : 1;
+        bool raw = out == "-";
+        if (!raw)
+            mkdir(out.c_str(), 0755);
+
+        // The canvas points into the bytes that are written out, PNG or raw
+        SoftRender::PngImage png(raw ? 1 : Config::WINDOW_W, raw ? 1 : Config::WINDOW_H);
+        if (!png.isValid()) {
+            cerr << "render: " << Config::WINDOW_W << " px is wider than a PNG row of stored blocks allows ("
+                 << SoftRender::PngImage::MAX_WIDTH << ")" << endl;
+            return 1;
+        }
+        vector<uint8_t> rawFrame(raw ? 3 * Config::WINDOW_W * Config::WINDOW_H : 0);
+        SoftRender::Canvas canvas = raw
+            ? SoftRender::Canvas(rawFrame.data(), Config::WINDOW_W, Config::WINDOW_H, 3 * Config::WINDOW_W)
+            : png.canvas();
+
+        Game game;
+        long frames = 0;
+        bool ok = true;
+        Clock::time_point start = Clock::now();
+        Replay::VerifyResult result = Replay::playback(replay, game, [&](int64_t tick) {
+            if (tick % every || !ok) return;
+            SoftRender::drawFrame(canvas, game);
+            if (raw) {
+                ok = fwrite(rawFrame.data(), 1, rawFrame.size(), stdout) == rawFrame.size();
+            } else {
+                const vector<uint8_t> &file = png.finish();
+                char path[512];
+                snprintf(path, sizeof(path), "%s/frame_%06ld.png", out.c_str(), frames);
+                FILE *f = fopen(path, "wb");
+                ok = f && fwrite(file.data(), 1, file.size(), f) == file.size();
+                if (f && fclose(f) != 0)
+                    ok = false;
+            }
+            frames++;
+        });
+        if (raw)
+            fflush(stdout);
+        double seconds = secondsSince(start);
+        double gameSeconds = (double)result.ticks * replay.getHeader().tickUs / 1e6;
+
+        // Progress goes to stderr when stdout carries the frames
+        ostream &log = raw ? cerr : cout;
+        log << frames << " frames (" << Config::WINDOW_W << "x" << Config::WINDOW_H << ") of a "
+            << gameSeconds << " s game in " << seconds << " s: " << frames / seconds << " fps, "
+            << gameSeconds / seconds << "x real time" << endl;
+        if (!ok) {
+            cerr << "render: error writing " << (raw ? "stdout" : out) << endl;
+            return 1;
+        }
+        if (!result.ok) {
+            cerr << "render: replay did not reproduce its recorded result" << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // profile [games] [pieces] [trace.json] [seed]: bot games paced one
+    // tick per frame, then per-frame percentiles of every zone and, with
+    // a path, a Chrome trace of the last frames. Needs -DTETRIS_PROFILE.
+    int runProfile(int argc, char **argv) {
+#ifdef TETRIS_PROFILE
+        int games = argc > 0 ? atoi(argv[0]) : 3;
+        long maxPieces = argc > 1 ? atol(argv[1]) : 300;
+        const char *tracePath = argc > 2 ? argv[2] : nullptr;
+        uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 10) : (uint64_t)time(nullptr);
+        const int64_t tickUs = 1000000 / Config::DEFAULT_TICK_RATE;
+
+        Game game;
+        Bot::AutoPlayer bot;
+        long ticks = 0;
+        Clock::time_point start = Clock::now();
+        for (int g = 0; g < games; g++) {
+            game.reset(seed + (uint64_t)g, Tetromino::RANDOMIZER_BAG7);
+            bot.reset();
+            while (!game.isGameOver() && game.getPiecesPlaced() < maxPieces) {
+                unsigned inputs = ticks % 2 == 0 ? bot.nextInput(game) : INPUT_NONE;
+                if (inputs)
+                    game.step(inputs, 0);
+                game.step(INPUT_NONE, tickUs);
+                Profiler::endFrame();
+                ticks++;
+            }
+        }
+        cout << games << " games, " << ticks << " frames in " << secondsSince(start) << " s" << endl;
+
+        Profiler::Percentiles frame = Profiler::framePercentiles(Profiler::ZONE_COUNT);
+        printf("last %d frames, ms        p50       p99       max   calls/frame\n", frame.frames);
+        printf("%-16s %9.4f %9.4f %9.4f\n", "frame", frame.p50, frame.p99, frame.max);
+        for (int z = 0; z < Profiler::ZONE_COUNT; z++) {
+            Profiler::Percentiles p = Profiler::framePercentiles(z);
+            printf("%-16s %9.4f %9.4f %9.4f %9.2f\n", Profiler::ZONE_NAMES[z], p.p50, p.p99, p.max, p.callsPerFrame);
+        }
+        fflush(stdout);
+        if (tracePath) {
+            if (!Profiler::exportTrace(tracePath)) {
+                cerr << "profile: cannot write " << tracePath << endl;
+                return 1;
+            }
+            cout << "trace written to " << tracePath << endl;
+        }
+        return 0;
+#else
+        (void)argc;
+        (void)argv;
+        cerr << "profile: built without -DTETRIS_PROFILE" << endl;
+        return 1;
+#endif
+    }
+
+    // undo [pieces] [depth] [seed]: plays games while pushing a state before
+    // every piece and, every few pieces, undoes up to depth levels at once,
+    // checking each restored game against what was seen when that state was
+    // live. Then times save and restore on their own.
+    int runUndo(int argc, char **argv) {
+        long pieces = argc > 0 ? atol(argv[0]) : 100000;
+        int depth = argc > 1 ? max(1, atoi(argv[1])) : 16;
+        uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : (uint64_t)time(nullptr);
+
+        struct Seen {
+            uint64_t hash;
+            int score;
+            int lines;
+            int current;
+            int next;
+
+            bool operator==(const Seen &o) const {
+                return hash == o.hash && score == o.score && lines == o.lines &&
+                       current == o.current && next == o.next;
+            }
+        };
+        auto observe = [](const Game &g) {
+            return Seen{g.getHash(), g.getBoard().getScore(), g.getBoard().getLinesClearedTotal(),
+                        g.getCurrentPiece().type, g.getNextPiece().type};
+        };
+
+        Game game(seed, Tetromino::RANDOMIZER_BAG7);
+        StateHistory history(depth);
+        Random::Xoshiro128 rng(seed);
+        vector<Seen> seen;              // One entry per push since the last restart
+        long undos = 0, levels = 0;
+        for (long i = 0; i < pieces; i++) {
+            if (game.isGameOver()) {
+                game.step(INPUT_RESTART, 0);
+                history.clear();
+                seen.clear();
+            }
+            history.push(game);
+            seen.push_back(observe(game));
+
+            if (i % 7 == 6) {
+                int k = 1 + (int)rng.nextBelow((uint32_t)history.size());
+                for (int j = 0; j < k; j++)
+                    history.pop(game);
+                // The restored state is pushed again before the next piece
+                Seen expected = seen[seen.size() - k];
+                seen.resize(seen.size() - k);
+                if (!(observe(game) == expected)) {
+                    cerr << "undo: FAILED, state restored " << k << " levels back does not match" << endl;
+                    return 1;
+                }
+                undos++;
+                levels += k;
+            }
+
+            if (rng.nextBelow(4) == 0)
+                SelfPlay::playRandomPlacement(game, rng);
+            else
+                playLowestPlacement(game);
+        }
+
+        const int rounds = 1000000;
+        GameState states[64];
+        uint64_t sink = 0;
+        Clock::time_point start = Clock::now();
+        for (int r = 0; r < rounds; r++) {
+            game.save(states[r & 63]);
+            sink ^= states[r & 63].board.hash;
+        }
+        double saveNs = secondsSince(start) * 1e9 / rounds;
+        start = Clock::now();
+        for (int r = 0; r < rounds; r++) {
+            game.restore(states[r & 63]);
+            sink ^= game.getHash();
+        }
+        double restoreNs = secondsSince(start) * 1e9 / rounds;
+
+        cout << pieces << " pieces, " << undos << " undos of " << (double)levels / max(1L, undos)
+             << " levels on average (history of " << depth << "): all restored states match" << endl;
+        cout << "GameState " << sizeof(GameState) << " bytes (board occupancy + caches "
+             << offsetof(BoardState, colors) << ", colour plane " << sizeof(BoardState::colors) << "): save "
+             << saveNs << " ns, restore " << restoreNs << " ns" << (sink ? "" : " ") << endl;
+        return 0;
+    }
+
+    // memory [boards]: bytes per board for each representation the server
+    // can hold (live boards, whole games, snapshots and the SoA batch), and
+    // what that many boards of each cost
+    int runMemory(int argc, char **argv) {
+        long boards = argc > 0 ? atol(argv[0]) : 100000;
+        if (boards <= 0) boards = 1;
+        const int batchSize = 1024;
+        Simulation::BoardBatch batch(batchSize, 1);
+
+        struct Entry {
+            const char *name;
+            double bytes;
+        };
+        const Entry entries[] = {
+            {"GameBoard", (double)sizeof(Board::GameBoard)},
+            {"Game", (double)sizeof(Game)},
+            {"BoardState", (double)sizeof(BoardState)},
+            {"GameState", (double)sizeof(GameState)},
+            {"BoardBatch", (double)batch.getBytes() / batchSize},
+        };
+
+        cout << "colour plane " << sizeof(BoardState::colors) << " bytes (" << BOARD_W << "x" << BOARD_H
+             << " cells at 4 bits), occupancy " << sizeof(BoardState::occupancy) << " bytes" << endl;
+        for (const Entry &e : entries) {
+            printf("%-11s %7.1f bytes/board, %8.2f MiB for %ld boards\n",
+                   e.name, e.bytes, e.bytes * boards / (1024.0 * 1024.0), boards);
+        }
+        return 0;
+    }
+
+    struct SizeResult {
+        const char *name;
+        int rowBytes;
+        size_t boardBytes;
+        long pieces;
+        long lines;
+        long games;
+        double seconds;
+    };
+
+    template <int W, int H>
+    SizeResult playSize(const char *name, long pieces, uint64_t seed) {
+        typedef BasicBoard<W, H> SizedBoard;
+        BasicGame<SizedBoard> game(seed, Tetromino::RANDOMIZER_BAG7);
+        SizeResult r = {name, (int)sizeof(typename SizedBoard::Row), sizeof(SizedBoard), 0, 0, 1, 0};
+        Clock::time_point start = Clock::now();
+        for (long i = 0; i < pieces; i++) {
+            if (game.isGameOver()) {
+                r.lines += game.getBoard().getLinesClearedTotal();
+                game.step(INPUT_RESTART, 0);
+                r.games++;
+            }
+            playLowestPlacement(game);
+        }
+        r.seconds = secondsSince(start);
+        r.pieces = pieces;
+        r.lines += game.getBoard().getLinesClearedTotal();
+        return r;
+    }
+
+    // sizes [pieces] [seed]: plays the same lowest-placement policy on
+    // several board sizes at once, one thread each, in one process: the
+    // standard 10x20, a 10x40 sprint buffer, and wide boards on 16-, 32-
+    // and 64-bit rows
+    int runSizes(int argc, char **argv) {
+        long pieces = argc > 0 ? atol(argv[0]) : 200000;
+        uint64_t seed = argc > 1 ? strtoull(argv[1], nullptr, 10) : (uint64_t)time(nullptr);
+
+        const int SIZES = 5;
+        SizeResult results[SIZES];
+        thread threads[SIZES] = {
+            thread([&] { results[0] = playSize<10, 20>("10x20", pieces, seed); }),
+            thread([&] { results[1] = playSize<10, 40>("10x40", pieces, seed); }),
+            thread([&] { results[2] = playSize<16, 24>("16x24", pieces, seed); }),
+            thread([&] { results[3] = playSize<24, 20>("24x20", pieces, seed); }),
+            thread([&] { results[4] = playSize<40, 30>("40x30", pieces, seed); }),
+        };
+        for (thread &t : threads)
+            t.join();
+
+        for (const SizeResult &r : results) {
+            printf("%-6s %d-byte rows, %4zu bytes/board: %ld pieces, %ld games, %ld lines, %.0f pieces/s\n",
+                   r.name, r.rowBytes, r.boardBytes, r.pieces, r.games, r.lines, r.pieces / r.seconds);
+        }
+        return 0;
+    }
+
+    // features [boards] [rounds] [seed]: checks every feature kernel the
+    // CPU supports against the scalar reference (mid-game boards, random
+    // noise boards and a live BoardBatch), then times each one for single
+    // boards and for the batched layout
+    int runFeatures(int argc, char **argv) {
+        int boards = argc > 0 ? atoi(argv[0]) : 4096;
+        int rounds = argc > 1 ? atoi(argv[1]) : 200;
+        uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : (uint64_t)time(nullptr);
+        if (boards <= 0) boards = 1;
+        if (rounds <= 0) rounds = 1;
+
+        // Row-major boards, then the same boards in BoardBatch layout
+        Random::Xoshiro128 rng(seed);
+        vector<RowMask> rows(boards * BOARD_H);
+        Game game(seed, Tetromino::RANDOMIZER_BAG7);
+        for (int i = 0; i < boards; i++) {
+            RowMask *board = &rows[i * BOARD_H];
+            if (i % 2) {
+                int top = (int)rng.nextBelow(BOARD_H + 1);
+                for (int y = top; y < BOARD_H; y++)
+                    board[y] = (RowMask)(rng.next() & FULL_ROW);
+                continue;
+            }
+            int pieces = 1 + (int)rng.nextBelow(30);
+            for (int p = 0; p < pieces; p++) {
+                if (game.isGameOver())
+                    game.step(INPUT_RESTART, 0);
+                if (rng.nextBelow(4) == 0)
+                    SelfPlay::playRandomPlacement(game, rng);
+                else
+                    playLowestPlacement(game);
+            }
+            memcpy(board, game.getBoard().getRows(), BOARD_H * sizeof(RowMask));
+        }
+        vector<RowMask> soa(boards * BOARD_H);
+        for (int i = 0; i < boards; i++) {
+            for (int y = 0; y < BOARD_H; y++)
+                soa[y * boards + i] = rows[i * BOARD_H + y];
+        }
+
+        Simulation::BoardBatch live(boards, seed);
+        vector<uint8_t> actions(boards);
+        for (int s = 0; s < 500; s++) {
+            for (int b = 0; b < boards; b++)
+                actions[b] = (uint8_t)rng.nextBelow(Simulation::ACTION_HARD_DROP + 1);
+            live.stepAll(actions.data());
+        }
+
+        vector<Features::BoardFeatures> expected(boards), expectedLive(boards);
+        for (int i = 0; i < boards; i++) {
+            expected[i] = Features::extractReference(&rows[i * BOARD_H]);
+            RowMask board[BOARD_H];
+            for (int y = 0; y < BOARD_H; y++)
+                board[y] = live.getRow(i, y);
+            expectedLive[i] = Features::extractReference(board);
+        }
+
+        Features::FeatureBatch out(boards);
+        long long checksum = 0;
+        cout << boards << " boards, best kernel " << Features::kernelName(Features::bestKernel()) << endl;
+        for (int k = 0; k < Features::KERNEL_COUNT; k++) {
+            Features::Kernel kernel = (Features::Kernel)k;
+            if (!Features::kernelSupported(kernel)) {
+                cout << Features::kernelName(kernel) << ": not supported on this CPU" << endl;
+                continue;
+            }
+
+            for (int i = 0; i < boards; i++) {
+                if (!(Features::extract(&rows[i * BOARD_H], kernel) == expected[i])) {
+                    cerr << "features: FAILED, " << Features::kernelName(kernel) << " board " << i << endl;
+                    return 1;
+                }
+            }
+            Features::extractBatch(soa.data(), boards, out, kernel);
+            for (int i = 0; i < boards; i++) {
+                if (!(out.get(i) == expected[i])) {
+                    cerr << "features: FAILED, " << Features::kernelName(kernel) << " batch board " << i << endl;
+                    return 1;
+                }
+            }
+            Features::extractBatch(live.getRows(), boards, out, kernel);
+            for (int i = 0; i < boards; i++) {
+                if (!(out.get(i) == expectedLive[i])) {
+                    cerr << "features: FAILED, " << Features::kernelName(kernel) << " BoardBatch board " << i << endl;
+                    return 1;
+                }
+            }
+
+            Clock::time_point start = Clock::now();
+            for (int r = 0; r < rounds; r++) {
+                for (int i = 0; i < boards; i++) {
+                    Features::BoardFeatures f = Features::extract(&rows[i * BOARD_H], kernel);
+                    checksum += f.holes + f.wells + f.rowTransitions;
+                }
+            }
+            double single = secondsSince(start);
+
+            start = Clock::now();
+            for (int r = 0; r < rounds; r++) {
+                Features::extractBatch(soa.data(), boards, out, kernel);
+                checksum += out.holes[r % boards];
+            }
+            double batched = secondsSince(start);
+
+            double total = (double)boards * rounds;
+            cout << Features::kernelName(kernel) << ": identical to reference; single "
+                 << total / single / 1e6 << " M boards/s, batch " << total / batched / 1e6 << " M boards/s" << endl;
+        }
+        cout << "checksum " << checksum << endl;
+        return 0;
+    }
+
+    // autoplay [games] [maxPieces] [threads] [beam] [budgetUs] [seed]
+    // [tableBits]: the beam-search bot as Game's only input source, for
+    // soak testing
+    int runAutoplay(int argc, char **argv) {
+        int games = argc > 0 ? atoi(argv[0]) : 10;
+        long maxPieces = argc > 1 ? atol(argv[1]) : 10000;
+        Bot::BotConfig config;
+        if (argc > 2) config.threads = max(1, atoi(argv[2]));
+        if (argc > 3) config.beamWidth = atoi(argv[3]);
+        if (argc > 4) config.budgetUs = atol(argv[4]);
+        uint64_t seed = argc > 5 ? strtoull(argv[5], nullptr, 10) : (uint64_t)time(nullptr);
+        if (argc > 6) config.tableBits = max(0, min(atoi(argv[6]), 30));
+
+        Bot::AutoPlayer bot(config);
+        Game game(seed, Tetromino::RANDOMIZER_BAG7);
+        long pieces = 0, lines = 0, plans = 0, expanded = 0, beam = 0;
+        long long score = 0;
+        Clock::time_point start = Clock::now();
+        for (int g = 0; g < games; g++) {
+            game.reset(seed + (uint64_t)g);
+            bot.reset();
+            long placed = 0;
+            while (!game.isGameOver() && game.getPiecesPlaced() < maxPieces) {
+                game.step(bot.nextInput(game), 0);
+                if (game.getPiecesPlaced() != placed) {
+                    placed = game.getPiecesPlaced();
+                    plans++;
+                    expanded += bot.getPlanner().getExpanded();
+                    beam += bot.getPlanner().getBeamSize();
+                }
+            }
+            pieces += game.getPiecesPlaced();
+            lines += game.getBoard().getLinesClearedTotal();
+            score += game.getBoard().getScore();
+            cout << "game " << g << ": " << game.getPiecesPlaced() << " pieces, "
+                 << game.getBoard().getLinesClearedTotal() << " lines, score " << game.getBoard().getScore()
+                 << (game.isGameOver() ? " (topped out)" : "") << endl;
+        }
+        double seconds = secondsSince(start);
+
+        int threads = bot.getPlanner().getConfig().threads;
+        cout << games << " games, " << (double)lines / games << " lines/game, "
+             << (double)score / games << " score/game" << endl;
+        cout << pieces << " pieces in " << seconds << " s: " << pieces / seconds << " pieces/s, "
+             << pieces / seconds / threads << " pieces/s per thread (" << threads << " threads, beam "
+             << bot.getPlanner().getConfig().beamWidth << ", "
+             << 100.0 * expanded / max(1L, beam) << "% of beam expanded within budget)" << endl;
+
+        if (const Search::TranspositionTable *table = bot.getPlanner().getTable()) {
+            Search::TranspositionTable::Stats stats = bot.getPlanner().getTableStats();
+            cout << "transposition table: " << table->size() << " slots (" << table->bytes() / 1024
+                 << " KiB), " << 100.0 * table->occupancy() << "% full, " << stats.probes << " probes, "
+                 << 100.0 * stats.hitRate() << "% hits, " << stats.overwrites << " overwrites" << endl;
+        }
+        return 0;
+    }
+
+    // placements [boards] [rounds] [seed]: builds mid-game boards (lowest
+    // placement with some random drops mixed in for overhangs), checks that
+    // every enumerated path really ends at its placement, then times the
+    // enumerator over all boards.
+    int runPlacements(int argc, char **argv) {
+        int boards = argc > 0 ? atoi(argv[0]) : 1000;
+        int rounds = argc > 1 ? atoi(argv[1]) : 20;
+        uint64_t seed = argc > 2 ? strtoull(argv[2], nullptr, 10) : (uint64_t)time(nullptr);
+        if (boards <= 0) boards = 1;
+        if (rounds <= 0) rounds = 1;
+
+        Random::Xoshiro128 rng(seed);
+        vector<Game> positions;
+        positions.reserve(boards);
+        while ((int)positions.size() < boards) {
+            Game game(rng.next(), Tetromino::RANDOMIZER_BAG7);
+            int pieces = 20 + (int)rng.nextBelow(60);
+            for (int i = 0; i < pieces && !game.isGameOver(); i++) {
+                if (rng.nextBelow(8) == 0)
+                    SelfPlay::playRandomPlacement(game, rng);
+                else
+                    playLowestPlacement(game);
+            }
+            if (!game.isGameOver())
+                positions.push_back(game);
+        }
+
+        unique_ptr<Search::PlacementEnumerator> search(new Search::PlacementEnumerator());
+        unsigned path[Search::PlacementEnumerator::STATE_COUNT + 1];
+        long checked = 0;
+        long holes = 0;
+        for (const Game &position : positions) {
+            holes += position.getBoard().getTotalHoles();
+            int n = search->enumerate(position.getBoard(), position.getCurrentPiece());
+            for (int i = 0; i < n; i++) {
+                const Search::Placement &p = search->get(i);
+                int length = search->pathTo(p, path, (int)(sizeof(path) / sizeof(path[0])));
+                Game replay = position;
+                for (int j = 0; j + 1 < length; j++)
+                    replay.step(path[j], 0);
+                const Piece &piece = replay.getCurrentPiece();
+                // The last entry is the hard drop, which must land exactly on p
+                if (length < 1 || piece.x != p.x || piece.rotation != p.rotation ||
+                    piece.y + replay.getBoard().dropDistance(piece) != p.y) {
+                    cerr << "placements: FAILED, path " << i << " does not reach its placement" << endl;
+                    return 1;
+                }
+                checked++;
+            }
+        }
+
+        long enumerations = 0;
+        long found = 0;
+        long states = 0;
+        Clock::time_point start = Clock::now();
+        for (int r = 0; r < rounds; r++) {
+            for (const Game &position : positions) {
+                found += search->enumerate(position.getBoard(), position.getCurrentPiece());
+                states += search->getStatesVisited();
+                enumerations++;
+            }
+        }
+        double seconds = secondsSince(start);
+
+        cout << boards << " boards (" << (double)holes / boards << " holes on average), "
+             << checked << " paths verified" << endl;
+        cout << enumerations << " enumerations in " << seconds << " s: "
+             << (double)found / enumerations << " placements and "
+             << (double)states / enumerations << " states per piece" << endl;
+        cout << enumerations / seconds << " pieces/s, " << found / seconds << " placements/s" << endl;
+        return 0;
+    }
+}
+
+// Usage: tetris_headless [sim|batch|selfplay|queue|alloccheck|placements|autoplay|features|replay|render|profile|undo|memory|sizes] [args...]
+int main(int argc, char **argv) {
+    string mode = argc > 1 ? argv[1] : "sim";
+    int restArgc = argc > 2 ? argc - 2 : 0;
+    char **restArgv = argv + 2;
+
+    if (mode == "sim") return Headless::runGames(restArgc, restArgv);
+    if (mode == "batch") return Headless::runBatch(restArgc, restArgv);
+    if (mode == "selfplay") return Headless::runSelfPlay(restArgc, restArgv);
+    if (mode == "queue") return Headless::runQueue(restArgc, restArgv);
+    if (mode == "alloccheck") return Headless::runAllocCheck(restArgc, restArgv);
+    if (mode == "placements") return Headless::runPlacements(restArgc, restArgv);
+    if (mode == "autoplay") return Headless::runAutoplay(restArgc, restArgv);
+    if (mode == "features") return Headless::runFeatures(restArgc, restArgv);
+    if (mode == "replay") return Headless::runReplay(restArgc, restArgv);
+    if (mode == "render") return Headless::runRender(restArgc, restArgv);
+    if (mode == "profile") return Headless::runProfile(restArgc, restArgv);
+    if (mode == "undo") return Headless::runUndo(restArgc, restArgv);
+    if (mode == "memory") return Headless::runMemory(restArgc, restArgv);
+    if (mode == "sizes") return Headless::runSizes(restArgc, restArgv);
+
+    cerr << "usage: " << argv[0] << " [sim|batch|selfplay|queue|alloccheck|placements|autoplay|features|replay|render|profile|undo|memory|sizes] [args...]" << endl;
+    return 1;
+}
+
+#endif // TETRIS_TUNER
 
+#endif // TETRIS_HEADLESS